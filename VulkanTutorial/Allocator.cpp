@@ -0,0 +1,271 @@
+#include "Allocator.hpp"
+#include "VulkanTutorial.hpp"
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool OnSamePage(VkDeviceSize lastByteOfFirst, VkDeviceSize firstByteOfSecond, VkDeviceSize pageSize)
+{
+	return lastByteOfFirst / pageSize == firstByteOfSecond / pageSize;
+}
+
+void GpuAllocator::Init(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize)
+{
+	m_device = device;
+	m_blockSize = blockSize;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	m_bufferImageGranularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+	m_maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+	spdlog::info("Created allocator with {} memory types, {} MiB blocks, bufferImageGranularity {}",
+		m_memoryProperties.memoryTypeCount, m_blockSize / (1024 * 1024), m_bufferImageGranularity);
+}
+
+void GpuAllocator::Destroy()
+{
+	for (auto& block : m_blocks)
+	{
+		if (block.memory != VK_NULL_HANDLE)
+			DestroyBlock(block);
+	}
+	m_blocks.clear();
+}
+
+uint32_t GpuAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+Allocation GpuAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+	AllocationKind kind)
+{
+	uint32_t memoryType = FindMemoryType(requirements.memoryTypeBits, properties);
+
+	uint32_t blockIndex = UINT32_MAX;
+	VkDeviceSize offset = 0;
+
+	// Resources bigger than half a block get their own allocation instead of stranding the rest of one.
+	if (requirements.size > m_blockSize / 2)
+	{
+		blockIndex = CreateBlock(memoryType, requirements.size, true);
+		TryAllocateFromBlock(m_blocks[blockIndex], requirements.size, requirements.alignment, kind, offset);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < m_blocks.size(); i++)
+		{
+			Block& block = m_blocks[i];
+			if (block.memory == VK_NULL_HANDLE || block.dedicated || block.memoryType != memoryType)
+				continue;
+
+			if (TryAllocateFromBlock(block, requirements.size, requirements.alignment, kind, offset))
+			{
+				blockIndex = i;
+				break;
+			}
+		}
+
+		if (blockIndex == UINT32_MAX)
+		{
+			blockIndex = CreateBlock(memoryType, m_blockSize, false);
+			TryAllocateFromBlock(m_blocks[blockIndex], requirements.size, requirements.alignment, kind, offset);
+		}
+	}
+
+	const Block& block = m_blocks[blockIndex];
+	Allocation allocation;
+	allocation.memory = block.memory;
+	allocation.offset = offset;
+	allocation.size = requirements.size;
+	allocation.memoryType = memoryType;
+	allocation.blockIndex = blockIndex;
+	allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+	return allocation;
+}
+
+void GpuAllocator::Free(const Allocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+		return;
+
+	Block& block = m_blocks[allocation.blockIndex];
+	auto used = block.usedRanges.find(allocation.offset);
+	if (used == block.usedRanges.end())
+	{
+		throw std::runtime_error("Freeing an allocation that is not owned by the allocator");
+	}
+
+	if (block.dedicated)
+	{
+		DestroyBlock(block);
+		return;
+	}
+
+	VkDeviceSize start = allocation.offset;
+	VkDeviceSize size = used->second.size;
+	block.usedRanges.erase(used);
+
+	// Coalesce with the free ranges on either side so the block does not splinter over time.
+	auto next = block.freeRanges.lower_bound(start);
+	if (next != block.freeRanges.end() && next->first == start + size)
+	{
+		size += next->second;
+		next = block.freeRanges.erase(next);
+	}
+	if (next != block.freeRanges.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == start)
+		{
+			previous->second += size;
+			return;
+		}
+	}
+	block.freeRanges[start] = size;
+}
+
+bool GpuAllocator::TryAllocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, AllocationKind kind,
+	VkDeviceSize& offset)
+{
+	for (auto range = block.freeRanges.begin(); range != block.freeRanges.end(); ++range)
+	{
+		VkDeviceSize rangeStart = range->first;
+		VkDeviceSize rangeEnd = range->first + range->second;
+		VkDeviceSize candidate = AlignUp(rangeStart, alignment);
+
+		auto next = block.usedRanges.lower_bound(rangeStart);
+		if (next != block.usedRanges.begin())
+		{
+			auto previous = std::prev(next);
+			if (previous->second.kind != kind &&
+				OnSamePage(previous->first + previous->second.size - 1, candidate, m_bufferImageGranularity))
+			{
+				candidate = AlignUp(candidate, m_bufferImageGranularity);
+			}
+		}
+
+		if (candidate + size > rangeEnd)
+			continue;
+
+		if (next != block.usedRanges.end() && next->second.kind != kind &&
+			OnSamePage(candidate + size - 1, next->first, m_bufferImageGranularity))
+			continue;
+
+		VkDeviceSize end = candidate + size;
+		block.freeRanges.erase(range);
+		if (candidate > rangeStart)
+			block.freeRanges[rangeStart] = candidate - rangeStart;
+		if (end < rangeEnd)
+			block.freeRanges[end] = rangeEnd - end;
+		block.usedRanges[candidate] = { size, kind };
+
+		offset = candidate;
+		return true;
+	}
+	return false;
+}
+
+uint32_t GpuAllocator::CreateBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated)
+{
+	uint32_t liveBlocks = 0;
+	uint32_t blockIndex = static_cast<uint32_t>(m_blocks.size());
+	for (uint32_t i = 0; i < m_blocks.size(); i++)
+	{
+		if (m_blocks[i].memory != VK_NULL_HANDLE)
+			liveBlocks++;
+		else if (blockIndex == m_blocks.size())
+			blockIndex = i;
+	}
+	if (liveBlocks >= m_maxAllocationCount)
+	{
+		throw std::runtime_error("Exceeded maxMemoryAllocationCount");
+	}
+
+	Block block;
+	block.size = size;
+	block.memoryType = memoryType;
+	block.dedicated = dedicated;
+	block.freeRanges[0] = size;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+	VK_CHECKERROR(
+		vkAllocateMemory(m_device, &allocInfo, nullptr, &block.memory),
+		"Failed to allocate memory block"
+	)
+
+	if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		VK_CHECKERROR(
+			vkMapMemory(m_device, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped),
+			"Failed to map memory block"
+		)
+	}
+
+	if (blockIndex == m_blocks.size())
+		m_blocks.push_back(std::move(block));
+	else
+		m_blocks[blockIndex] = std::move(block);
+
+	spdlog::info("Allocated {} memory block {} of {} KiB on type {}", dedicated ? "dedicated" : "shared", blockIndex,
+		size / 1024, memoryType);
+	return blockIndex;
+}
+
+void GpuAllocator::DestroyBlock(Block& block)
+{
+	if (block.mapped)
+		vkUnmapMemory(m_device, block.memory);
+	vkFreeMemory(m_device, block.memory, nullptr);
+	block = Block{};
+}
+
+AllocatorStatistics GpuAllocator::GetStatistics() const
+{
+	AllocatorStatistics statistics;
+	VkDeviceSize freeBytes = 0;
+	for (const auto& block : m_blocks)
+	{
+		if (block.memory == VK_NULL_HANDLE)
+			continue;
+
+		statistics.blockCount++;
+		statistics.blockBytes += block.size;
+		statistics.allocationCount += static_cast<uint32_t>(block.usedRanges.size());
+		for (const auto& [offset, used] : block.usedRanges)
+			statistics.usedBytes += used.size;
+
+		statistics.freeRangeCount += static_cast<uint32_t>(block.freeRanges.size());
+		for (const auto& [offset, size] : block.freeRanges)
+		{
+			freeBytes += size;
+			statistics.largestFreeRange = std::max(statistics.largestFreeRange, size);
+		}
+	}
+
+	if (freeBytes > 0)
+		statistics.fragmentation = 1.0f - static_cast<float>(statistics.largestFreeRange) / freeBytes;
+	return statistics;
+}
+
+void GpuAllocator::LogStatistics() const
+{
+	AllocatorStatistics statistics = GetStatistics();
+	spdlog::info("Allocator: {} allocations in {} blocks, {} KiB used of {} KiB, {} free ranges, fragmentation {:.2f}",
+		statistics.allocationCount, statistics.blockCount, statistics.usedBytes / 1024, statistics.blockBytes / 1024,
+		statistics.freeRangeCount, statistics.fragmentation);
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <map>
+
+// Linear resources (buffers, linear images) and optimal-tiling images must not share a
+// bufferImageGranularity page, so every sub-allocation remembers which kind it is.
+enum class AllocationKind : uint8_t
+{
+	Linear,
+	Optimal
+};
+
+struct Allocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	uint32_t memoryType = 0;
+	uint32_t blockIndex = 0;
+	// Host-visible blocks stay mapped for their whole lifetime, this points at the allocation's first byte.
+	void* mapped = nullptr;
+};
+
+struct AllocatorStatistics
+{
+	uint32_t blockCount = 0;
+	uint32_t allocationCount = 0;
+	uint32_t freeRangeCount = 0;
+	VkDeviceSize blockBytes = 0;
+	VkDeviceSize usedBytes = 0;
+	VkDeviceSize largestFreeRange = 0;
+	// 0 when all free space is one contiguous range, approaching 1 as it gets split into small holes.
+	float fragmentation = 0.0f;
+};
+
+class GpuAllocator
+{
+public:
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = 64ull * 1024 * 1024);
+	void Destroy();
+
+	const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const { return m_memoryProperties; }
+	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	Allocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, AllocationKind kind);
+	void Free(const Allocation& allocation);
+
+	AllocatorStatistics GetStatistics() const;
+	void LogStatistics() const;
+
+private:
+	struct UsedRange
+	{
+		VkDeviceSize size;
+		AllocationKind kind;
+	};
+
+	struct Block
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryType = 0;
+		void* mapped = nullptr;
+		bool dedicated = false;
+		// Both keyed by offset, so neighbours of a range are found with one map lookup.
+		std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+		std::map<VkDeviceSize, UsedRange> usedRanges;
+	};
+
+	bool TryAllocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment, AllocationKind kind,
+	                          VkDeviceSize& offset);
+	uint32_t CreateBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated);
+	void DestroyBlock(Block& block);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+	VkDeviceSize m_bufferImageGranularity = 1;
+	uint32_t m_maxAllocationCount = 0;
+	VkDeviceSize m_blockSize = 0;
+	std::vector<Block> m_blocks;
+};
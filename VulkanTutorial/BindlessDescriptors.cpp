@@ -0,0 +1,175 @@
+#include "BindlessDescriptors.hpp"
+#include "VulkanTutorial.hpp"
+
+static const char* BINDING_NAMES[] = { "storage buffer", "sampled image", "sampler" };
+
+bool BindlessDescriptors::CheckSupport(const VkPhysicalDeviceVulkan12Features& supported,
+	VkPhysicalDeviceVulkan12Features& enabled)
+{
+	if (!supported.runtimeDescriptorArray || !supported.descriptorBindingPartiallyBound ||
+		!supported.descriptorBindingStorageBufferUpdateAfterBind ||
+		!supported.descriptorBindingSampledImageUpdateAfterBind ||
+		!supported.descriptorBindingUpdateUnusedWhilePending ||
+		!supported.shaderStorageBufferArrayNonUniformIndexing ||
+		!supported.shaderSampledImageArrayNonUniformIndexing)
+		return false;
+
+	enabled.descriptorIndexing = supported.descriptorIndexing;
+	enabled.runtimeDescriptorArray = VK_TRUE;
+	enabled.descriptorBindingPartiallyBound = VK_TRUE;
+	enabled.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	enabled.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	enabled.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	enabled.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+	enabled.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	return true;
+}
+
+void BindlessDescriptors::Init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t maxBuffers,
+	uint32_t maxImages, uint32_t maxSamplers)
+{
+	m_device = device;
+
+	VkPhysicalDeviceVulkan12Properties properties12{};
+	properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &properties12;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	m_slots[StorageBuffers].capacity = std::min({ maxBuffers,
+		properties12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+		properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+	m_slots[SampledImages].capacity = std::min({ maxImages,
+		properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+		properties12.maxPerStageDescriptorUpdateAfterBindSampledImages });
+	// Samplers are few, the plain limits apply to them.
+	m_slots[Samplers].capacity = std::min({ maxSamplers, properties.properties.limits.maxDescriptorSetSamplers,
+		properties.properties.limits.maxPerStageDescriptorSamplers });
+
+	const VkDescriptorType types[] = {
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_SAMPLER
+	};
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+	std::array<VkDescriptorBindingFlags, 3> bindingFlags{};
+	std::array<VkDescriptorPoolSize, 3> poolSizes{};
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = types[i];
+		bindings[i].descriptorCount = m_slots[i].capacity;
+		bindings[i].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+		bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+		if (types[i] != VK_DESCRIPTOR_TYPE_SAMPLER)
+			bindingFlags[i] |= VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+		poolSizes[i].type = types[i];
+		poolSizes[i].descriptorCount = m_slots[i].capacity;
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+	VK_CHECKERROR(
+		vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_setLayout),
+		"Failed to create bindless descriptor set layout"
+	)
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	VK_CHECKERROR(
+		vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_pool),
+		"Failed to create bindless descriptor pool"
+	)
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_setLayout;
+	VK_CHECKERROR(
+		vkAllocateDescriptorSets(m_device, &allocInfo, &m_set),
+		"Failed to allocate bindless descriptor set"
+	)
+
+	spdlog::info("Created bindless descriptors: {} buffers, {} images, {} samplers",
+		m_slots[StorageBuffers].capacity, m_slots[SampledImages].capacity, m_slots[Samplers].capacity);
+}
+
+void BindlessDescriptors::Destroy()
+{
+	vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+	vkDestroyDescriptorSetLayout(m_device, m_setLayout, nullptr);
+}
+
+uint32_t BindlessDescriptors::RegisterBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	uint32_t index = AllocateSlot(StorageBuffers);
+	VkDescriptorBufferInfo bufferInfo{ buffer, offset, range };
+	Write(StorageBuffers, index, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &bufferInfo, nullptr);
+	return index;
+}
+
+uint32_t BindlessDescriptors::RegisterImage(VkImageView imageView, VkImageLayout layout)
+{
+	uint32_t index = AllocateSlot(SampledImages);
+	VkDescriptorImageInfo imageInfo{ VK_NULL_HANDLE, imageView, layout };
+	Write(SampledImages, index, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, nullptr, &imageInfo);
+	return index;
+}
+
+uint32_t BindlessDescriptors::RegisterSampler(VkSampler sampler)
+{
+	uint32_t index = AllocateSlot(Samplers);
+	VkDescriptorImageInfo imageInfo{ sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+	Write(Samplers, index, VK_DESCRIPTOR_TYPE_SAMPLER, nullptr, &imageInfo);
+	return index;
+}
+
+void BindlessDescriptors::Release(Binding binding, uint32_t index)
+{
+	m_slots[binding].free.push_back(index);
+}
+
+uint32_t BindlessDescriptors::AllocateSlot(Binding binding)
+{
+	Slots& slots = m_slots[binding];
+	if (!slots.free.empty())
+	{
+		uint32_t index = slots.free.back();
+		slots.free.pop_back();
+		return index;
+	}
+	if (slots.next == slots.capacity)
+	{
+		throw std::runtime_error(std::string("Out of bindless ") + BINDING_NAMES[binding] + " slots (" +
+			std::to_string(slots.capacity) + ")");
+	}
+	return slots.next++;
+}
+
+void BindlessDescriptors::Write(Binding binding, uint32_t index, VkDescriptorType type,
+	const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo)
+{
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = m_set;
+	write.dstBinding = binding;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+	write.pBufferInfo = bufferInfo;
+	write.pImageInfo = imageInfo;
+	vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+
+// One global descriptor set holding every storage buffer, sampled image and sampler the renderer uses,
+// in large update-after-bind arrays. Shaders reach a resource through its index, so adding one is a
+// descriptor write instead of a new set, and a frame binds this set once. Slots are written as soon as
+// a resource is registered; unused slots are left unwritten (partially bound).
+class BindlessDescriptors
+{
+public:
+	enum Binding : uint32_t
+	{
+		StorageBuffers = 0,
+		SampledImages = 1,
+		Samplers = 2
+	};
+
+	// Checks the descriptor indexing features CreateLogicalDevice must enable, filling enabled with them.
+	static bool CheckSupport(const VkPhysicalDeviceVulkan12Features& supported, VkPhysicalDeviceVulkan12Features& enabled);
+
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t maxBuffers = 4096, uint32_t maxImages = 4096,
+	          uint32_t maxSamplers = 64);
+	void Destroy();
+
+	// Each returns the index shaders use to reach the resource.
+	uint32_t RegisterBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	uint32_t RegisterImage(VkImageView imageView, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// Sampler slots are not update-after-bind, register samplers before recording any command buffer.
+	uint32_t RegisterSampler(VkSampler sampler);
+	// Returns the slot for reuse. No submitted frame may still read it.
+	void Release(Binding binding, uint32_t index);
+
+	VkDescriptorSetLayout GetSetLayout() const { return m_setLayout; }
+	VkDescriptorSet GetSet() const { return m_set; }
+
+private:
+	struct Slots
+	{
+		uint32_t capacity = 0;
+		uint32_t next = 0;
+		std::vector<uint32_t> free;
+	};
+
+	uint32_t AllocateSlot(Binding binding);
+	void Write(Binding binding, uint32_t index, VkDescriptorType type, const VkDescriptorBufferInfo* bufferInfo,
+	           const VkDescriptorImageInfo* imageInfo);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool m_pool = VK_NULL_HANDLE;
+	VkDescriptorSet m_set = VK_NULL_HANDLE;
+	Slots m_slots[3];
+};
@@ -0,0 +1,105 @@
+#include "DeletionQueue.hpp"
+#include "VulkanTutorial.hpp"
+
+void DeletionQueue::Init(VkDevice device, GpuAllocator& allocator)
+{
+	m_device = device;
+	m_allocator = &allocator;
+}
+
+void DeletionQueue::Destroy()
+{
+	Collect(UINT64_MAX);
+	spdlog::info("Destroyed deletion queue, {} objects released after {} submissions", m_destroyed,
+		m_submissionCount);
+}
+
+uint64_t DeletionQueue::Submitted()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return ++m_submissionCount;
+}
+
+void DeletionQueue::Collect(uint64_t completedSubmission)
+{
+	std::vector<std::function<void()>> ready;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_completedSubmissions = std::max(m_completedSubmissions, completedSubmission);
+		while (!m_entries.empty() && m_entries.front().lastSubmission <= m_completedSubmissions)
+		{
+			ready.push_back(std::move(m_entries.front().destroy));
+			m_entries.pop_front();
+		}
+		m_destroyed += ready.size();
+	}
+	// Outside the lock, so a destroy function may queue something of its own.
+	for (std::function<void()>& destroy : ready)
+		destroy();
+}
+
+void DeletionQueue::Push(std::function<void()> destroy)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.push_back({ m_submissionCount + 1, std::move(destroy) });
+}
+
+void DeletionQueue::PushBuffer(VkBuffer buffer, const Allocation& allocation)
+{
+	Push([this, buffer, allocation]()
+	{
+		vkDestroyBuffer(m_device, buffer, nullptr);
+		m_allocator->Free(allocation);
+	});
+}
+
+void DeletionQueue::PushImage(VkImage image, const Allocation& allocation)
+{
+	Push([this, image, allocation]()
+	{
+		vkDestroyImage(m_device, image, nullptr);
+		m_allocator->Free(allocation);
+	});
+}
+
+void DeletionQueue::PushImageView(VkImageView imageView)
+{
+	Push([this, imageView]() { vkDestroyImageView(m_device, imageView, nullptr); });
+}
+
+void DeletionQueue::PushFramebuffer(VkFramebuffer frameBuffer)
+{
+	Push([this, frameBuffer]() { vkDestroyFramebuffer(m_device, frameBuffer, nullptr); });
+}
+
+void DeletionQueue::PushPipeline(VkPipeline pipeline)
+{
+	Push([this, pipeline]() { vkDestroyPipeline(m_device, pipeline, nullptr); });
+}
+
+void DeletionQueue::PushSwapChain(VkSwapchainKHR swapChain)
+{
+	Push([this, swapChain]() { vkDestroySwapchainKHR(m_device, swapChain, nullptr); });
+}
+
+void DeletionQueue::PushCommandBuffers(VkCommandPool commandPool, std::vector<VkCommandBuffer> commandBuffers)
+{
+	if (commandBuffers.empty())
+		return;
+	Push([this, commandPool, commandBuffers = std::move(commandBuffers)]()
+	{
+		vkFreeCommandBuffers(m_device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+	});
+}
+
+size_t DeletionQueue::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.size();
+}
+
+uint64_t DeletionQueue::GetDestroyedCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_destroyed;
+}
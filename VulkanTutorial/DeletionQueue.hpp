@@ -0,0 +1,55 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "Allocator.hpp"
+
+// Takes ownership of objects the GPU may still be using and destroys them once every queue submission
+// that could use them has finished: those made before the push and the one after it, which may have
+// been recorded against the object already. Submissions are counted as they are made and complete in
+// order, so the count a frame's fence covers is enough to know which objects are free to go, and nothing
+// needs vkDeviceWaitIdle to release a resource at runtime. Objects are destroyed in push order.
+class DeletionQueue
+{
+public:
+	void Init(VkDevice device, GpuAllocator& allocator);
+	// Destroys everything still queued, so the device must be idle.
+	void Destroy();
+
+	// Counts a queue submission and returns its number, to be passed to Collect once it has finished.
+	uint64_t Submitted();
+	// Destroys the objects no submission after completedSubmission can use.
+	void Collect(uint64_t completedSubmission);
+
+	void Push(std::function<void()> destroy);
+	void PushBuffer(VkBuffer buffer, const Allocation& allocation);
+	void PushImage(VkImage image, const Allocation& allocation);
+	void PushImageView(VkImageView imageView);
+	void PushFramebuffer(VkFramebuffer frameBuffer);
+	void PushPipeline(VkPipeline pipeline);
+	void PushSwapChain(VkSwapchainKHR swapChain);
+	void PushCommandBuffers(VkCommandPool commandPool, std::vector<VkCommandBuffer> commandBuffers);
+
+	size_t GetPendingCount() const;
+	uint64_t GetDestroyedCount() const;
+
+private:
+	struct Entry
+	{
+		// The submission following the push, the last one that may use the object.
+		uint64_t lastSubmission = 0;
+		std::function<void()> destroy;
+	};
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	GpuAllocator* m_allocator = nullptr;
+
+	mutable std::mutex m_mutex;
+	std::deque<Entry> m_entries;
+	uint64_t m_submissionCount = 0;
+	uint64_t m_completedSubmissions = 0;
+	uint64_t m_destroyed = 0;
+};
@@ -0,0 +1,218 @@
+#include "GpuCuller.hpp"
+#include "VulkanTutorial.hpp"
+
+static const uint32_t CULL_GROUP_SIZE = 64;
+
+// Matches the push constants of res/cull.glsl (std430).
+struct CullParameters
+{
+	glm::vec4 boundingSphere;
+	glm::vec4 lodErrors;
+	glm::uvec4 lodFirstIndices;
+	glm::uvec4 lodIndexCounts;
+	glm::vec2 viewportHalfSize;
+	float lodErrorPixels;
+	uint32_t lodCount;
+	uint32_t objectCount;
+};
+static_assert(MAX_MESH_LODS == 4, "res/cull.glsl holds the LOD table in vec4s");
+
+void GpuCuller::Init(VkDevice device, GpuAllocator& allocator, VkPipelineCache pipelineCache, LayoutCache& layouts,
+	const std::string& shaderPath, const std::vector<Bindings>& frames, uint32_t maxObjects)
+{
+	m_device = device;
+	m_allocator = &allocator;
+	m_maxObjects = std::max(maxObjects, 1u);
+
+	std::vector<char> code = IO::ReadFile(shaderPath);
+	ShaderReflection reflection = ReflectSpirv(code.data(), code.size());
+	if (reflection.bindings.size() != 3 || reflection.pushConstantSize != sizeof(CullParameters))
+	{
+		throw std::runtime_error(shaderPath + " does not match the cull pass's buffers and parameters");
+	}
+	LayoutCache::ProgramLayout layout = layouts.GetProgramLayout({ reflection });
+	m_descriptorSetLayout = layout.setLayouts[0];
+	m_pipelineLayout = layout.pipelineLayout;
+	VkShaderModuleCreateInfo moduleInfo{};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = code.size();
+	moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	VkShaderModule shaderModule;
+	VK_CHECKERROR(
+		vkCreateShaderModule(m_device, &moduleInfo, nullptr, &shaderModule),
+		"Failed to create cull shader module"
+	)
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = m_pipelineLayout;
+	VkResult result = vkCreateComputePipelines(m_device, pipelineCache, 1, &pipelineInfo, nullptr, &m_pipeline);
+	vkDestroyShaderModule(m_device, shaderModule, nullptr);
+	VK_CHECKERROR(result, "Failed to create cull pipeline")
+
+	std::array<VkDescriptorPoolSize, 1> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(frames.size() * reflection.bindings.size());
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = static_cast<uint32_t>(frames.size());
+	VK_CHECKERROR(
+		vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool),
+		"Failed to create cull descriptor pool"
+	)
+
+	m_frames.resize(frames.size());
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		FrameBuffers& frame = m_frames[i];
+		CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * m_maxObjects,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, AllocationKind::Linear, frame.drawBuffer, frame.drawAllocation);
+		CreateBuffer(sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, AllocationKind::Linear, frame.countBuffer, frame.countAllocation);
+		CreateBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, AllocationKind::Linear,
+			frame.readbackBuffer, frame.readbackAllocation);
+		*static_cast<uint32_t*>(frame.readbackAllocation.mapped) = 0;
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = m_descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &m_descriptorSetLayout;
+		VK_CHECKERROR(
+			vkAllocateDescriptorSets(m_device, &allocInfo, &frame.descriptorSet),
+			"Failed to allocate cull descriptor set"
+		)
+
+		VkDescriptorBufferInfo bufferInfos[3] = {
+			{ frames[i].instanceBuffer, 0, VK_WHOLE_SIZE },
+			{ frame.drawBuffer, 0, VK_WHOLE_SIZE },
+			{ frame.countBuffer, 0, VK_WHOLE_SIZE },
+		};
+		std::array<VkWriteDescriptorSet, 3> writes{};
+		for (uint32_t j = 0; j < writes.size(); j++)
+		{
+			writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[j].dstSet = frame.descriptorSet;
+			writes[j].dstBinding = j;
+			writes[j].descriptorCount = 1;
+			writes[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[j].pBufferInfo = &bufferInfos[j];
+		}
+		vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	spdlog::info("Created GPU culling for up to {} objects", m_maxObjects);
+}
+
+void GpuCuller::Destroy()
+{
+	for (FrameBuffers& frame : m_frames)
+	{
+		vkDestroyBuffer(m_device, frame.drawBuffer, nullptr);
+		m_allocator->Free(frame.drawAllocation);
+		vkDestroyBuffer(m_device, frame.countBuffer, nullptr);
+		m_allocator->Free(frame.countAllocation);
+		vkDestroyBuffer(m_device, frame.readbackBuffer, nullptr);
+		m_allocator->Free(frame.readbackAllocation);
+	}
+	m_frames.clear();
+	vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+	vkDestroyPipeline(m_device, m_pipeline, nullptr);
+}
+
+void GpuCuller::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+	AllocationKind kind, VkBuffer& buffer, Allocation& allocation)
+{
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VK_CHECKERROR(
+		vkCreateBuffer(m_device, &bufferInfo, nullptr, &buffer),
+		"Failed to create cull buffer"
+	)
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
+	allocation = m_allocator->Allocate(memRequirements, properties, kind);
+	vkBindBufferMemory(m_device, buffer, allocation.memory, allocation.offset);
+}
+
+void GpuCuller::RecordCull(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t objectCount,
+	const std::vector<MeshLod>& lods, const glm::vec4& boundingSphere, const glm::vec2& viewportHalfSize,
+	float lodErrorPixels)
+{
+	FrameBuffers& buffers = m_frames[frame];
+	objectCount = std::min(objectCount, m_maxObjects);
+
+	// The previous use of this frame's buffers finished before its fence signaled, so only the clear
+	// has to be ordered before the compute pass.
+	vkCmdFillBuffer(commandBuffer, buffers.countBuffer, 0, sizeof(uint32_t), 0);
+	VkMemoryBarrier clearBarrier{};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+	CullParameters parameters{};
+	parameters.boundingSphere = boundingSphere;
+	parameters.lodCount = std::min(static_cast<uint32_t>(lods.size()), MAX_MESH_LODS);
+	for (uint32_t i = 0; i < parameters.lodCount; i++)
+	{
+		parameters.lodErrors[i] = lods[i].error;
+		parameters.lodFirstIndices[i] = lods[i].firstIndex;
+		parameters.lodIndexCounts[i] = lods[i].indexCount;
+	}
+	parameters.viewportHalfSize = viewportHalfSize;
+	parameters.lodErrorPixels = lodErrorPixels;
+	parameters.objectCount = objectCount;
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1,
+		&buffers.descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(parameters),
+		&parameters);
+	vkCmdDispatch(commandBuffer, (objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	VkMemoryBarrier cullBarrier{};
+	cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &cullBarrier, 0, nullptr, 0,
+		nullptr);
+
+	VkBufferCopy copy{ 0, 0, sizeof(uint32_t) };
+	vkCmdCopyBuffer(commandBuffer, buffers.countBuffer, buffers.readbackBuffer, 1, &copy);
+
+	VkMemoryBarrier readbackBarrier{};
+	readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+		&readbackBarrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuCuller::RecordDraw(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+	FrameBuffers& buffers = m_frames[frame];
+	vkCmdDrawIndexedIndirectCount(commandBuffer, buffers.drawBuffer, 0, buffers.countBuffer, 0, m_maxObjects,
+		sizeof(VkDrawIndexedIndirectCommand));
+}
+
+uint32_t GpuCuller::GetVisibleCount(uint32_t frame) const
+{
+	return *static_cast<const uint32_t*>(m_frames[frame].readbackAllocation.mapped);
+}
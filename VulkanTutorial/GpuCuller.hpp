@@ -0,0 +1,62 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "Allocator.hpp"
+#include "LayoutCache.hpp"
+#include "MeshSimplifier.hpp"
+
+// GPU-driven drawing: a compute pass tests every instance's bounding sphere against the view frustum
+// and appends one VkDrawIndexedIndirectCommand per visible instance, at the LOD its screen-space error
+// allows, and a single vkCmdDrawIndexedIndirectCount draws them. The CPU records the same few commands
+// however many objects the scene has.
+class GpuCuller
+{
+public:
+	struct Bindings
+	{
+		VkBuffer instanceBuffer;
+	};
+
+	// The descriptor set and pipeline layouts are reflected from the shader and owned by layouts.
+	void Init(VkDevice device, GpuAllocator& allocator, VkPipelineCache pipelineCache, LayoutCache& layouts,
+	          const std::string& shaderPath, const std::vector<Bindings>& frames, uint32_t maxObjects);
+	void Destroy();
+
+	// Records the cull dispatch for the frame. Must be outside a render pass.
+	void RecordCull(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t objectCount,
+	                const std::vector<MeshLod>& lods, const glm::vec4& boundingSphere,
+	                const glm::vec2& viewportHalfSize, float lodErrorPixels);
+	// Records the indirect draw of whatever the frame's cull pass kept. Pipeline and vertex/index buffers
+	// must already be bound.
+	void RecordDraw(VkCommandBuffer commandBuffer, uint32_t frame);
+
+	// Visible instances of the frame's last cull. Only valid once its fence has signaled.
+	uint32_t GetVisibleCount(uint32_t frame) const;
+
+private:
+	struct FrameBuffers
+	{
+		VkBuffer drawBuffer = VK_NULL_HANDLE;
+		Allocation drawAllocation;
+		VkBuffer countBuffer = VK_NULL_HANDLE;
+		Allocation countAllocation;
+		VkBuffer readbackBuffer = VK_NULL_HANDLE;
+		Allocation readbackAllocation;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	};
+
+	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+	                  AllocationKind kind, VkBuffer& buffer, Allocation& allocation);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	GpuAllocator* m_allocator = nullptr;
+	uint32_t m_maxObjects = 0;
+	// Owned by the LayoutCache passed to Init.
+	VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+	VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_pipeline = VK_NULL_HANDLE;
+	std::vector<FrameBuffers> m_frames;
+};
@@ -0,0 +1,230 @@
+#include "GpuProfiler.hpp"
+#include "VulkanTutorial.hpp"
+
+#include <fstream>
+
+// Bounds the trace so a long interactive session does not grow it without limit.
+static const size_t MAX_TRACE_EVENTS = 1u << 20;
+
+void GpuProfiler::Init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily,
+	uint32_t framesInFlight, uint32_t maxScopes)
+{
+	m_device = device;
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamilies[queueFamily].timestampValidBits;
+	if (validBits == 0)
+	{
+		spdlog::warn("Queue family {} does not support timestamps, GPU profiling disabled", queueFamily);
+		return;
+	}
+	m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	m_nanosecondsPerTick = properties.limits.timestampPeriod;
+
+	m_maxQueries = 2 * maxScopes;
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = m_maxQueries;
+
+	m_frames.resize(framesInFlight);
+	for (FrameQueries& frame : m_frames)
+	{
+		VK_CHECKERROR(
+			vkCreateQueryPool(m_device, &queryPoolInfo, nullptr, &frame.pool),
+			"Failed to create timestamp query pool"
+		)
+	}
+	spdlog::info("Created {} GPU profiler query pools of {} timestamps", framesInFlight, m_maxQueries);
+}
+
+void GpuProfiler::Destroy()
+{
+	for (FrameQueries& frame : m_frames)
+		vkDestroyQueryPool(m_device, frame.pool, nullptr);
+	m_frames.clear();
+	m_recording = nullptr;
+}
+
+void GpuProfiler::Collect(uint32_t frame)
+{
+	if (!IsEnabled())
+		return;
+
+	FrameQueries& queries = m_frames[frame];
+	if (!queries.pending || queries.queryCount == 0)
+		return;
+	queries.pending = false;
+
+	// No WAIT flag: the fence already signaled, and if the driver still disagrees the frame is dropped
+	// rather than stalling the CPU.
+	std::vector<uint64_t> timestamps(queries.queryCount);
+	VkResult result = vkGetQueryPoolResults(m_device, queries.pool, 0, queries.queryCount,
+		timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	uint32_t queryCount = queries.queryCount;
+	if (result != VK_SUCCESS)
+		return;
+
+	if (!m_hasTraceOrigin)
+	{
+		m_traceOrigin = timestamps[0];
+		m_hasTraceOrigin = true;
+	}
+
+	for (const Scope& scope : queries.scopes)
+	{
+		if (scope.endQuery >= queryCount)
+			continue;
+
+		uint64_t ticks = (timestamps[scope.endQuery] - timestamps[scope.beginQuery]) & m_timestampMask;
+		double milliseconds = ticks * m_nanosecondsPerTick / 1e6;
+		uint32_t index = GetScopeIndex(scope.name);
+		m_scopeTimes[index].Add(milliseconds);
+
+		if (m_trace.size() < MAX_TRACE_EVENTS)
+		{
+			uint64_t start = (timestamps[scope.beginQuery] - m_traceOrigin) & m_timestampMask;
+			m_trace.push_back({ index, queries.frameNumber, start * m_nanosecondsPerTick / 1e3,
+				milliseconds * 1e3 });
+		}
+	}
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+	if (!IsEnabled())
+		return;
+
+	m_recording = &m_frames[frame];
+	m_recording->scopes.clear();
+	m_recording->queryCount = 0;
+	m_recording->frameNumber = m_frameCounter++;
+	m_recording->pending = true;
+	m_openScopes.clear();
+	vkCmdResetQueryPool(commandBuffer, m_recording->pool, 0, m_maxQueries);
+}
+
+void GpuProfiler::Resubmit(uint32_t frame)
+{
+	if (!IsEnabled())
+		return;
+
+	m_frames[frame].frameNumber = m_frameCounter++;
+	m_frames[frame].pending = true;
+}
+
+void GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, const char* name)
+{
+	if (m_recording == nullptr)
+		return;
+
+	// Out of queries: the scope is silently dropped, EndScope still balances the stack. Open scopes
+	// still need one query each for their end.
+	uint32_t pendingEnds = static_cast<uint32_t>(std::count_if(m_openScopes.begin(), m_openScopes.end(),
+		[](uint32_t scope) { return scope != UINT32_MAX; }));
+	if (m_recording->queryCount + pendingEnds + 2 > m_maxQueries)
+	{
+		m_openScopes.push_back(UINT32_MAX);
+		return;
+	}
+
+	uint32_t query = m_recording->queryCount++;
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_recording->pool, query);
+	m_openScopes.push_back(static_cast<uint32_t>(m_recording->scopes.size()));
+	m_recording->scopes.push_back({ name, query, UINT32_MAX });
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer)
+{
+	if (m_recording == nullptr || m_openScopes.empty())
+		return;
+
+	uint32_t scope = m_openScopes.back();
+	m_openScopes.pop_back();
+	if (scope == UINT32_MAX)
+		return;
+
+	uint32_t query = m_recording->queryCount++;
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_recording->pool, query);
+	m_recording->scopes[scope].endQuery = query;
+}
+
+uint32_t GpuProfiler::GetScopeIndex(const std::string& name)
+{
+	auto it = m_scopeIndices.find(name);
+	if (it != m_scopeIndices.end())
+		return it->second;
+
+	uint32_t index = static_cast<uint32_t>(m_scopeNames.size());
+	m_scopeNames.push_back(name);
+	m_scopeTimes.emplace_back();
+	m_scopeIndices.emplace(name, index);
+	return index;
+}
+
+void GpuProfiler::ResetStatistics()
+{
+	for (MetricSeries& series : m_scopeTimes)
+		series.Clear();
+}
+
+MetricSummary GpuProfiler::GetSummary(const std::string& name) const
+{
+	auto it = m_scopeIndices.find(name);
+	if (it == m_scopeIndices.end())
+		return {};
+	return m_scopeTimes[it->second].Summarize();
+}
+
+void GpuProfiler::Log() const
+{
+	if (m_scopeNames.empty())
+		return;
+
+	spdlog::info("GPU scopes:");
+	for (size_t i = 0; i < m_scopeNames.size(); i++)
+	{
+		MetricSummary summary = m_scopeTimes[i].Summarize();
+		spdlog::info("  {:<18} min {:8.3f} ms  avg {:8.3f} ms  p99 {:8.3f} ms  max {:8.3f} ms", m_scopeNames[i],
+			summary.min, summary.avg, summary.p99, summary.max);
+	}
+}
+
+std::string GpuProfiler::ToJson() const
+{
+	std::string json = "{";
+	for (size_t i = 0; i < m_scopeNames.size(); i++)
+	{
+		json += fmt::format("{} \"{}\": {}", i == 0 ? "" : ",", m_scopeNames[i],
+			SummaryToJson(m_scopeTimes[i].Summarize()));
+	}
+	return json + " }";
+}
+
+void GpuProfiler::WriteChromeTrace(const std::string& path) const
+{
+	std::ofstream trace(path);
+	if (!trace.is_open())
+	{
+		throw std::runtime_error("Failed to open GPU trace " + path);
+	}
+
+	trace << "{ \"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	trace << "  { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": { \"name\": \"GPU\" } }";
+	for (const TraceEvent& event : m_trace)
+	{
+		trace << fmt::format(",\n  {{ \"name\": \"{}\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": {:.3f}, "
+			"\"dur\": {:.3f}, \"args\": {{ \"frame\": {} }} }}", m_scopeNames[event.scope], event.startMicroseconds,
+			event.durationMicroseconds, event.frameNumber);
+	}
+	trace << "\n] }\n";
+
+	spdlog::info("Wrote {} GPU trace events to {}", m_trace.size(), path);
+}
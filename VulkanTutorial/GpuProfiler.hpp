@@ -0,0 +1,81 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Telemetry.hpp"
+
+// Measures named GPU scopes with timestamp queries. Every frame in flight owns its own query pool,
+// so the results of a frame are read once its fence has signaled and the CPU never waits for them.
+class GpuProfiler
+{
+public:
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily, uint32_t framesInFlight,
+	          uint32_t maxScopes = 64);
+	void Destroy();
+
+	bool IsEnabled() const { return !m_frames.empty(); }
+
+	// Reads back what the slot recorded the last time it was used. Call after its fence has signaled.
+	void Collect(uint32_t frame);
+	// Starts recording the slot's scopes into commandBuffer.
+	void BeginFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+	// The slot is about to submit a command buffer recorded earlier with the same scopes; its queries
+	// will be written again, so collect them again.
+	void Resubmit(uint32_t frame);
+	void BeginScope(VkCommandBuffer commandBuffer, const char* name);
+	void EndScope(VkCommandBuffer commandBuffer);
+
+	// Drops the per-scope statistics, e.g. between benchmark runs. The trace is kept.
+	void ResetStatistics();
+	MetricSummary GetSummary(const std::string& name) const;
+	void Log() const;
+	std::string ToJson() const;
+	// Writes every collected scope as a complete event in the Chrome trace event format
+	// (chrome://tracing, Perfetto).
+	void WriteChromeTrace(const std::string& path) const;
+
+private:
+	struct Scope
+	{
+		std::string name;
+		uint32_t beginQuery;
+		uint32_t endQuery;
+	};
+
+	struct FrameQueries
+	{
+		VkQueryPool pool = VK_NULL_HANDLE;
+		std::vector<Scope> scopes;
+		uint32_t queryCount = 0;
+		uint64_t frameNumber = 0;
+		bool pending = false;
+	};
+
+	struct TraceEvent
+	{
+		uint32_t scope;
+		uint64_t frameNumber;
+		double startMicroseconds;
+		double durationMicroseconds;
+	};
+
+	uint32_t GetScopeIndex(const std::string& name);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	double m_nanosecondsPerTick = 0.0;
+	uint64_t m_timestampMask = 0;
+	uint32_t m_maxQueries = 0;
+
+	std::vector<FrameQueries> m_frames;
+	FrameQueries* m_recording = nullptr;
+	std::vector<uint32_t> m_openScopes;
+	uint64_t m_frameCounter = 0;
+
+	std::vector<std::string> m_scopeNames;
+	std::unordered_map<std::string, uint32_t> m_scopeIndices;
+	std::vector<MetricSeries> m_scopeTimes;
+	std::vector<TraceEvent> m_trace;
+	bool m_hasTraceOrigin = false;
+	uint64_t m_traceOrigin = 0;
+};
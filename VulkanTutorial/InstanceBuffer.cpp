@@ -0,0 +1,133 @@
+#include "InstanceBuffer.hpp"
+#include "VulkanTutorial.hpp"
+
+void InstanceBuffer::Init(VkDevice device, GpuAllocator& allocator, uint32_t framesInFlight, uint32_t capacity)
+{
+	m_device = device;
+	m_allocator = &allocator;
+	m_capacity = std::max(capacity, 1u);
+	m_frames.resize(framesInFlight);
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = sizeof(InstanceData) * m_capacity;
+	// Also read as a storage buffer by the GPU culling pass.
+	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	for (FrameCopy& frame : m_frames)
+	{
+		VK_CHECKERROR(
+			vkCreateBuffer(m_device, &bufferInfo, nullptr, &frame.buffer),
+			"Failed to create instance buffer"
+		)
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(m_device, frame.buffer, &memRequirements);
+		frame.allocation = m_allocator->Allocate(memRequirements,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, AllocationKind::Linear);
+		vkBindBufferMemory(m_device, frame.buffer, frame.allocation.memory, frame.allocation.offset);
+		frame.dirtyFlags.assign(m_capacity, false);
+	}
+
+	spdlog::info("Created {} instance buffers for {} instances", m_frames.size(), m_capacity);
+}
+
+void InstanceBuffer::Destroy()
+{
+	for (FrameCopy& frame : m_frames)
+	{
+		vkDestroyBuffer(m_device, frame.buffer, nullptr);
+		m_allocator->Free(frame.allocation);
+	}
+	m_frames.clear();
+	m_transforms.clear();
+}
+
+void InstanceBuffer::Resize(uint32_t count)
+{
+	if (count > m_capacity)
+	{
+		throw std::runtime_error("Instance count " + std::to_string(count) + " exceeds the capacity of " +
+			std::to_string(m_capacity));
+	}
+
+	uint32_t oldCount = GetCount();
+	m_transforms.resize(count, glm::mat4(1.0f));
+	for (uint32_t i = oldCount; i < count; i++)
+		MarkDirty(i);
+}
+
+void InstanceBuffer::SetTransform(uint32_t index, const glm::mat4& transform)
+{
+	m_transforms[index] = transform;
+	MarkDirty(index);
+}
+
+glm::mat4* InstanceBuffer::WriteTransforms(uint32_t first, uint32_t count)
+{
+	if (first == 0 && count == GetCount())
+	{
+		for (FrameCopy& frame : m_frames)
+			frame.allDirty = true;
+	}
+	else
+	{
+		for (uint32_t i = first; i < first + count; i++)
+			MarkDirty(i);
+	}
+	return m_transforms.data() + first;
+}
+
+void InstanceBuffer::MarkDirty(uint32_t index)
+{
+	for (FrameCopy& frame : m_frames)
+	{
+		if (frame.allDirty || frame.dirtyFlags[index])
+			continue;
+		frame.dirtyFlags[index] = true;
+		frame.dirty.push_back(index);
+	}
+}
+
+VkDeviceSize InstanceBuffer::Sync(uint32_t frame)
+{
+	FrameCopy& copy = m_frames[frame];
+	InstanceData* mapped = static_cast<InstanceData*>(copy.allocation.mapped);
+	if (copy.allDirty)
+	{
+		memcpy(mapped, m_transforms.data(), sizeof(InstanceData) * GetCount());
+		for (uint32_t index : copy.dirty)
+			copy.dirtyFlags[index] = false;
+		copy.dirty.clear();
+		copy.allDirty = false;
+		return sizeof(InstanceData) * GetCount();
+	}
+	if (copy.dirty.empty())
+		return 0;
+
+	std::sort(copy.dirty.begin(), copy.dirty.end());
+	VkDeviceSize bytesWritten = 0;
+
+	size_t rangeBegin = 0;
+	for (size_t i = 1; i <= copy.dirty.size(); i++)
+	{
+		if (i < copy.dirty.size() && copy.dirty[i] == copy.dirty[i - 1] + 1)
+			continue;
+
+		// Instances dropped by a Resize since they were marked have nothing to write.
+		uint32_t first = copy.dirty[rangeBegin];
+		uint32_t last = std::min(copy.dirty[i - 1] + 1, GetCount());
+		if (first < last)
+		{
+			memcpy(mapped + first, m_transforms.data() + first, sizeof(InstanceData) * (last - first));
+			bytesWritten += sizeof(InstanceData) * (last - first);
+		}
+		rangeBegin = i;
+	}
+
+	for (uint32_t index : copy.dirty)
+		copy.dirtyFlags[index] = false;
+	copy.dirty.clear();
+	return bytesWritten;
+}
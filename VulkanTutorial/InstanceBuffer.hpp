@@ -0,0 +1,48 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Allocator.hpp"
+
+// Per-instance matrices, with one persistently mapped copy per frame in flight so the CPU never
+// writes a buffer the GPU may still be reading. Each copy remembers which instances changed since it
+// was last written, and Sync copies only those, coalesced into contiguous ranges.
+class InstanceBuffer
+{
+public:
+	void Init(VkDevice device, GpuAllocator& allocator, uint32_t framesInFlight, uint32_t capacity);
+	void Destroy();
+
+	// Grows or shrinks the live instance count within the capacity. New instances start as identity.
+	void Resize(uint32_t count);
+	uint32_t GetCount() const { return static_cast<uint32_t>(m_transforms.size()); }
+	uint32_t GetCapacity() const { return m_capacity; }
+
+	void SetTransform(uint32_t index, const glm::mat4& transform);
+	const glm::mat4& GetTransform(uint32_t index) const { return m_transforms[index]; }
+	// Marks [first, first + count) changed and returns them to be written in place.
+	glm::mat4* WriteTransforms(uint32_t first, uint32_t count);
+
+	// Brings the frame's copy up to date and returns how many bytes were written.
+	VkDeviceSize Sync(uint32_t frame);
+	VkBuffer GetBuffer(uint32_t frame) const { return m_frames[frame].buffer; }
+
+private:
+	struct FrameCopy
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		Allocation allocation;
+		std::vector<uint32_t> dirty;
+		std::vector<bool> dirtyFlags;
+		// Every instance changed, so Sync copies them all at once instead of walking the dirty list.
+		bool allDirty = false;
+	};
+
+	void MarkDirty(uint32_t index);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	GpuAllocator* m_allocator = nullptr;
+	uint32_t m_capacity = 0;
+	std::vector<glm::mat4> m_transforms;
+	std::vector<FrameCopy> m_frames;
+};
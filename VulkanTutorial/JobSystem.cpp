@@ -0,0 +1,104 @@
+#include "JobSystem.hpp"
+#include "VulkanTutorial.hpp"
+
+static thread_local uint32_t t_workerIndex = 0;
+
+void JobSystem::Init(uint32_t threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+	m_stopping = false;
+	for (uint32_t i = 0; i < threadCount; i++)
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+
+	spdlog::info("Started {} worker threads", threadCount);
+}
+
+void JobSystem::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_jobAvailable.notify_all();
+	for (auto& worker : m_workers)
+		worker.join();
+	m_workers.clear();
+	m_jobs.clear();
+}
+
+void JobSystem::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_jobAvailable.notify_one();
+}
+
+void JobSystem::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this] { return m_jobs.empty() && m_activeJobs == 0; });
+}
+
+void JobSystem::ParallelFor(uint32_t taskCount, const std::function<void(uint32_t task, uint32_t worker)>& body)
+{
+	if (taskCount == 0)
+		return;
+
+	// Shared so helpers that only get to run after every task is done can still look at it safely;
+	// they find no task left and never touch body.
+	struct Batch
+	{
+		std::atomic<uint32_t> next = 0;
+		std::atomic<uint32_t> done = 0;
+	};
+	auto batch = std::make_shared<Batch>();
+	auto run = [batch, taskCount, &body](uint32_t worker)
+	{
+		for (uint32_t task = batch->next++; task < taskCount; task = batch->next++)
+		{
+			body(task, worker);
+			if (++batch->done == taskCount)
+				batch->done.notify_all();
+		}
+	};
+
+	uint32_t helpers = std::min(GetWorkerCount(), taskCount - 1);
+	for (uint32_t i = 0; i < helpers; i++)
+		Submit([run] { run(t_workerIndex); });
+	run(GetWorkerCount());
+
+	for (uint32_t done = batch->done.load(); done < taskCount; done = batch->done.load())
+		batch->done.wait(done);
+}
+
+void JobSystem::WorkerLoop(uint32_t workerIndex)
+{
+	t_workerIndex = workerIndex;
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobAvailable.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+			if (m_stopping)
+				return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+			m_activeJobs++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_activeJobs--;
+			if (m_jobs.empty() && m_activeJobs == 0)
+				m_idle.notify_all();
+		}
+	}
+}
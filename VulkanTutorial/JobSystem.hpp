@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads fed from one FIFO queue.
+class JobSystem
+{
+public:
+	// threadCount 0 uses one worker per hardware thread, minus the main thread.
+	void Init(uint32_t threadCount = 0);
+	void Shutdown();
+
+	void Submit(std::function<void()> job);
+	// Blocks until the queue is empty and no worker is running a job.
+	void WaitIdle();
+	// Runs body(task, worker) for every task in [0, taskCount) on the workers and the calling thread and
+	// returns once all tasks have finished. worker identifies the executing thread: 0..GetWorkerCount()-1
+	// for workers and GetWorkerCount() for the caller, so it can index per-thread resources.
+	void ParallelFor(uint32_t taskCount, const std::function<void(uint32_t task, uint32_t worker)>& body);
+
+	uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+private:
+	void WorkerLoop(uint32_t workerIndex);
+
+	std::vector<std::thread> m_workers;
+	std::deque<std::function<void()>> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_idle;
+	uint32_t m_activeJobs = 0;
+	bool m_stopping = false;
+};
@@ -0,0 +1,238 @@
+#include "LayoutCache.hpp"
+#include "VulkanTutorial.hpp"
+
+template <class T>
+static void AppendKey(std::string& key, const T& value)
+{
+	key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static VkDescriptorType GetDescriptorType(const ReflectedBinding& binding, bool dynamicUniformBuffers)
+{
+	return dynamicUniformBuffers && binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ?
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : binding.type;
+}
+
+static std::string GetLocation(const ReflectedBinding& binding)
+{
+	return "set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding);
+}
+
+void LayoutCache::Init(VkDevice device)
+{
+	m_device = device;
+}
+
+void LayoutCache::Destroy()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	spdlog::info("Destroyed layout cache: {} set layouts, {} pipeline layouts", m_setLayouts.size(),
+		m_pipelineLayouts.size());
+	for (auto& [key, pipelineLayout] : m_pipelineLayouts)
+		vkDestroyPipelineLayout(m_device, pipelineLayout, nullptr);
+	for (auto& [key, setLayout] : m_setLayouts)
+		vkDestroyDescriptorSetLayout(m_device, setLayout, nullptr);
+	m_pipelineLayouts.clear();
+	m_setLayouts.clear();
+	m_programs.clear();
+}
+
+VkDescriptorSetLayout LayoutCache::GetSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings)
+{
+	std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a,
+		const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+	std::string key;
+	for (const VkDescriptorSetLayoutBinding& binding : bindings)
+	{
+		AppendKey(key, binding.binding);
+		AppendKey(key, binding.descriptorType);
+		AppendKey(key, binding.descriptorCount);
+		AppendKey(key, binding.stageFlags);
+		AppendKey(key, binding.pImmutableSamplers);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto existing = m_setLayouts.find(key);
+	if (existing != m_setLayouts.end())
+		return existing->second;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+	VkDescriptorSetLayout setLayout;
+	VK_CHECKERROR(
+		vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &setLayout),
+		"Failed to create descriptor set layout"
+	)
+	m_setLayouts.emplace(std::move(key), setLayout);
+	return setLayout;
+}
+
+VkPipelineLayout LayoutCache::GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+	const std::vector<VkPushConstantRange>& pushConstantRanges)
+{
+	std::string key;
+	AppendKey(key, setLayouts.size());
+	for (VkDescriptorSetLayout setLayout : setLayouts)
+		AppendKey(key, setLayout);
+	for (const VkPushConstantRange& range : pushConstantRanges)
+	{
+		AppendKey(key, range.stageFlags);
+		AppendKey(key, range.offset);
+		AppendKey(key, range.size);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto existing = m_pipelineLayouts.find(key);
+	if (existing != m_pipelineLayouts.end())
+		return existing->second;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+	pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+	VkPipelineLayout pipelineLayout;
+	VK_CHECKERROR(
+		vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &pipelineLayout),
+		"Failed to create pipeline layout"
+	)
+	m_pipelineLayouts.emplace(std::move(key), pipelineLayout);
+	return pipelineLayout;
+}
+
+LayoutCache::ProgramLayout LayoutCache::GetProgramLayout(const std::vector<ShaderReflection>& shaders,
+	const std::map<uint32_t, VkDescriptorSetLayout>& externalSets, bool dynamicUniformBuffers)
+{
+	uint32_t setCount = externalSets.empty() ? 0 : externalSets.rbegin()->first + 1;
+	for (const ShaderReflection& shader : shaders)
+	{
+		for (const ReflectedBinding& binding : shader.bindings)
+			setCount = std::max(setCount, binding.set + 1);
+	}
+
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets(setCount);
+	VkPushConstantRange pushConstants{};
+	for (const ShaderReflection& shader : shaders)
+	{
+		if (shader.pushConstantSize != 0)
+		{
+			pushConstants.stageFlags |= shader.stage;
+			pushConstants.size = std::max(pushConstants.size, (shader.pushConstantSize + 3) / 4 * 4);
+		}
+		for (const ReflectedBinding& reflected : shader.bindings)
+		{
+			std::string location = GetLocation(reflected);
+			if (reflected.count == 0 && !externalSets.count(reflected.set))
+			{
+				throw std::runtime_error("Runtime-sized descriptor array at " + location + " needs an external set layout");
+			}
+
+			VkDescriptorType type = GetDescriptorType(reflected, dynamicUniformBuffers);
+			std::vector<VkDescriptorSetLayoutBinding>& set = sets[reflected.set];
+			auto existing = std::find_if(set.begin(), set.end(),
+				[&](const VkDescriptorSetLayoutBinding& binding) { return binding.binding == reflected.binding; });
+			if (existing == set.end())
+			{
+				set.push_back({ reflected.binding, type, reflected.count, static_cast<VkShaderStageFlags>(shader.stage), nullptr });
+			}
+			else if (existing->descriptorType != type || existing->descriptorCount != reflected.count)
+			{
+				throw std::runtime_error("Shaders declare different descriptors at " + location);
+			}
+			else
+			{
+				existing->stageFlags |= shader.stage;
+			}
+		}
+	}
+
+	ProgramLayout layout;
+	layout.setLayouts.resize(setCount);
+	for (uint32_t set = 0; set < setCount; set++)
+	{
+		auto external = externalSets.find(set);
+		layout.setLayouts[set] = external != externalSets.end() ? external->second : GetSetLayout(sets[set]);
+	}
+	std::vector<VkPushConstantRange> pushConstantRanges;
+	if (pushConstants.size != 0)
+		pushConstantRanges.push_back(pushConstants);
+	layout.pipelineLayout = GetPipelineLayout(layout.setLayouts, pushConstantRanges);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ProgramDescription& description = m_programs[layout.pipelineLayout];
+	if (description.sets.empty())
+	{
+		description.sets = std::move(sets);
+		description.pushConstants = pushConstants;
+		description.dynamicUniformBuffers = dynamicUniformBuffers;
+	}
+	else
+	{
+		// Another program shares the layout. Only its external sets can add bindings.
+		description.sets.resize(std::max(description.sets.size(), sets.size()));
+		for (size_t set = 0; set < sets.size(); set++)
+		{
+			for (const VkDescriptorSetLayoutBinding& binding : sets[set])
+			{
+				std::vector<VkDescriptorSetLayoutBinding>& known = description.sets[set];
+				auto existing = std::find_if(known.begin(), known.end(),
+					[&](const VkDescriptorSetLayoutBinding& other) { return other.binding == binding.binding; });
+				if (existing == known.end())
+					known.push_back(binding);
+				else
+					existing->stageFlags |= binding.stageFlags;
+			}
+		}
+	}
+	return layout;
+}
+
+void LayoutCache::CheckCompatible(VkPipelineLayout pipelineLayout, const ShaderReflection& shader,
+	const std::string& shaderName) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto program = m_programs.find(pipelineLayout);
+	if (program == m_programs.end())
+		return;
+
+	const ProgramDescription& description = program->second;
+	for (const ReflectedBinding& reflected : shader.bindings)
+	{
+		const VkDescriptorSetLayoutBinding* binding = nullptr;
+		if (reflected.set < description.sets.size())
+		{
+			for (const VkDescriptorSetLayoutBinding& candidate : description.sets[reflected.set])
+			{
+				if (candidate.binding == reflected.binding)
+					binding = &candidate;
+			}
+		}
+		if (binding == nullptr || binding->descriptorType != GetDescriptorType(reflected, description.dynamicUniformBuffers) ||
+			binding->descriptorCount != reflected.count || (binding->stageFlags & shader.stage) == 0)
+		{
+			throw std::runtime_error(shaderName + " declares a descriptor at " + GetLocation(reflected) +
+				" that its pipeline layout does not provide");
+		}
+	}
+	if (shader.pushConstantSize != 0 && ((description.pushConstants.stageFlags & shader.stage) == 0 ||
+		description.pushConstants.size < shader.pushConstantSize))
+	{
+		throw std::runtime_error(shaderName + " declares " + std::to_string(shader.pushConstantSize) +
+			" bytes of push constants, more than its pipeline layout provides");
+	}
+}
+
+size_t LayoutCache::GetSetLayoutCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_setLayouts.size();
+}
+
+size_t LayoutCache::GetPipelineLayoutCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pipelineLayouts.size();
+}
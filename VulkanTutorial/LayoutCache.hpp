@@ -0,0 +1,64 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SpirvReflection.hpp"
+
+// Descriptor set and pipeline layouts keyed by their full description, so every request for the same
+// layout gets the one created first. The cache owns them all until Destroy.
+class LayoutCache
+{
+public:
+	struct ProgramLayout
+	{
+		// Indexed by set number.
+		std::vector<VkDescriptorSetLayout> setLayouts;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	};
+
+	void Init(VkDevice device);
+	void Destroy();
+
+	// Bindings may come in any order.
+	VkDescriptorSetLayout GetSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+	VkPipelineLayout GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+	                                   const std::vector<VkPushConstantRange>& pushConstantRanges);
+
+	// One layout for a group of shaders that share descriptor sets: their bindings are merged, visible to
+	// every stage that uses them, and their push constants become one range. Sets in externalSets use
+	// that layout instead of a reflected one, which is how sets with flags reflection cannot see (such
+	// as update-after-bind) are provided. dynamicUniformBuffers makes every reflected uniform buffer
+	// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC.
+	ProgramLayout GetProgramLayout(const std::vector<ShaderReflection>& shaders,
+	                               const std::map<uint32_t, VkDescriptorSetLayout>& externalSets = {},
+	                               bool dynamicUniformBuffers = false);
+
+	// Throws if the shader uses a descriptor or push constants that the layout, as GetProgramLayout built
+	// it, does not provide to the shader's stage. Used to reject hot-reloaded shaders whose interface
+	// changed. Layouts that did not come from GetProgramLayout are not checked.
+	void CheckCompatible(VkPipelineLayout pipelineLayout, const ShaderReflection& shader,
+	                     const std::string& shaderName) const;
+
+	size_t GetSetLayoutCount() const;
+	size_t GetPipelineLayoutCount() const;
+
+private:
+	// The merged shader interface a program layout was built from. External sets are kept as the shaders
+	// declared them, since their layouts cannot be read back.
+	struct ProgramDescription
+	{
+		std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+		VkPushConstantRange pushConstants{};
+		bool dynamicUniformBuffers = false;
+	};
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	mutable std::mutex m_mutex;
+	// Keyed by the bytes of the description.
+	std::unordered_map<std::string, VkDescriptorSetLayout> m_setLayouts;
+	std::unordered_map<std::string, VkPipelineLayout> m_pipelineLayouts;
+	std::unordered_map<VkPipelineLayout, ProgramDescription> m_programs;
+};
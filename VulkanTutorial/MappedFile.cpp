@@ -0,0 +1,107 @@
+#include "MappedFile.hpp"
+#include "VulkanTutorial.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+void IO::MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error(std::string("File " + path + " Not found"));
+	}
+	m_file = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		Close();
+		throw std::runtime_error("Failed to get the size of " + path);
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+	if (m_size == 0)
+		return;
+
+	m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping != nullptr)
+		m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_data == nullptr)
+	{
+		Close();
+		throw std::runtime_error("Failed to map " + path);
+	}
+}
+
+void IO::MappedFile::Close()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != nullptr)
+		CloseHandle(m_file);
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = nullptr;
+	m_size = 0;
+}
+
+#else
+
+void IO::MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	m_file = open(path.c_str(), O_RDONLY);
+	if (m_file < 0)
+	{
+		throw std::runtime_error(std::string("File " + path + " Not found"));
+	}
+
+	struct stat info;
+	if (fstat(m_file, &info) != 0)
+	{
+		Close();
+		throw std::runtime_error("Failed to get the size of " + path);
+	}
+	m_size = static_cast<size_t>(info.st_size);
+	if (m_size == 0)
+		return;
+
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		throw std::runtime_error("Failed to map " + path);
+	}
+	// The file is streamed into the staging ring front to back exactly once.
+	madvise(data, m_size, MADV_SEQUENTIAL);
+	m_data = data;
+}
+
+void IO::MappedFile::Close()
+{
+	if (m_data != nullptr)
+		munmap(const_cast<void*>(m_data), m_size);
+	if (m_file >= 0)
+		close(m_file);
+	m_data = nullptr;
+	m_file = -1;
+	m_size = 0;
+}
+
+#endif
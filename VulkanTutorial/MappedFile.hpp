@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace IO
+{
+	// Read-only view of a whole file mapped into the address space. Pages are faulted in by the OS as
+	// they are touched, so nothing is read up front and nothing is copied into a heap buffer.
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		explicit MappedFile(const std::string& path) { Open(path); }
+		~MappedFile() { Close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		void Open(const std::string& path);
+		void Close();
+
+		const void* GetData() const { return m_data; }
+		size_t GetSize() const { return m_size; }
+
+	private:
+		const void* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#else
+		int m_file = -1;
+#endif
+	};
+}
@@ -0,0 +1,321 @@
+#include "Mesh.hpp"
+#include "VulkanTutorial.hpp"
+#include "MeshOptimizer.hpp"
+
+#include <charconv>
+#include <fstream>
+#include <unordered_map>
+
+static const uint32_t MESH_FILE_MAGIC = 0x48534D56; // "VMSH"
+static const uint32_t MESH_FILE_VERSION = 1;
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void MeshFile::Open(const std::string& path)
+{
+	Close();
+	m_file.Open(path);
+
+	if (m_file.GetSize() < sizeof(MeshFileHeader))
+	{
+		Close();
+		throw std::runtime_error("Mesh " + path + " is truncated");
+	}
+
+	const MeshFileHeader* header = static_cast<const MeshFileHeader*>(m_file.GetData());
+	uint64_t vertexEnd = header->vertexOffset + static_cast<uint64_t>(header->vertexCount) * header->vertexStride;
+	uint64_t indexEnd = header->indexOffset + static_cast<uint64_t>(header->indexCount) * header->indexSize;
+	if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION)
+	{
+		Close();
+		throw std::runtime_error("Mesh " + path + " is not a version " + std::to_string(MESH_FILE_VERSION) +
+			" .vmesh file");
+	}
+	if (header->vertexStride != sizeof(Vertex) || (header->indexSize != 2 && header->indexSize != 4) ||
+		vertexEnd > m_file.GetSize() || indexEnd > m_file.GetSize())
+	{
+		Close();
+		throw std::runtime_error("Mesh " + path + " is corrupt");
+	}
+	m_header = header;
+
+	spdlog::info("Mapped mesh {}: {} vertices, {} triangles, {}-bit indices", path, header->vertexCount,
+		header->indexCount / 3, header->indexSize * 8);
+}
+
+void MeshFile::Close()
+{
+	m_header = nullptr;
+	m_file.Close();
+}
+
+const void* MeshFile::GetVertices() const
+{
+	return static_cast<const char*>(m_file.GetData()) + m_header->vertexOffset;
+}
+
+VkDeviceSize MeshFile::GetVertexBytes() const
+{
+	return static_cast<VkDeviceSize>(m_header->vertexCount) * m_header->vertexStride;
+}
+
+const void* MeshFile::GetIndices() const
+{
+	return static_cast<const char*>(m_file.GetData()) + m_header->indexOffset;
+}
+
+VkDeviceSize MeshFile::GetIndexBytes() const
+{
+	return static_cast<VkDeviceSize>(m_header->indexCount) * m_header->indexSize;
+}
+
+VkIndexType MeshFile::GetIndexType() const
+{
+	return m_header->indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+void WriteMeshFile(const std::string& path, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	MeshFileHeader header{};
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.vertexCount = static_cast<uint32_t>(vertices.size());
+	header.vertexStride = sizeof(Vertex);
+	header.indexCount = static_cast<uint32_t>(indices.size());
+	header.indexSize = vertices.size() > 65535 ? 4 : 2;
+	header.vertexOffset = AlignUp(sizeof(MeshFileHeader), 16);
+	header.indexOffset = AlignUp(header.vertexOffset + vertices.size() * sizeof(Vertex), 16);
+
+	glm::vec3 boundsMin(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+	for (const Vertex& vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
+	}
+	if (vertices.empty())
+		boundsMin = boundsMax = glm::vec3(0.0f);
+	for (int i = 0; i < 3; i++)
+	{
+		header.boundsMin[i] = boundsMin[i];
+		header.boundsMax[i] = boundsMax[i];
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open " + path + " for writing");
+	}
+
+	static const char padding[16] = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(padding, header.vertexOffset - sizeof(header));
+	file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+	file.write(padding, header.indexOffset - (header.vertexOffset + vertices.size() * sizeof(Vertex)));
+	if (header.indexSize == 2)
+	{
+		std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+		file.write(reinterpret_cast<const char*>(shortIndices.data()), shortIndices.size() * sizeof(uint16_t));
+	}
+	else
+	{
+		file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+	}
+
+	if (!file)
+	{
+		throw std::runtime_error("Failed to write " + path);
+	}
+}
+
+namespace
+{
+	// Minimal cursor over the mapped OBJ text; every read stops at the end of the current line.
+	struct ObjCursor
+	{
+		const char* current;
+		const char* end;
+
+		void SkipSpaces()
+		{
+			while (current < end && (*current == ' ' || *current == '\t' || *current == '\r'))
+				current++;
+		}
+
+		void NextLine()
+		{
+			while (current < end && *current != '\n')
+				current++;
+			if (current < end)
+				current++;
+		}
+
+		bool AtLineEnd()
+		{
+			SkipSpaces();
+			return current >= end || *current == '\n' || *current == '#';
+		}
+
+		bool ReadFloat(float& value)
+		{
+			SkipSpaces();
+			if (current < end && *current == '+')
+				current++;
+			auto result = std::from_chars(current, end, value);
+			if (result.ec != std::errc())
+				return false;
+			current = result.ptr;
+			return true;
+		}
+
+		bool ReadInt(int64_t& value)
+		{
+			auto result = std::from_chars(current, end, value);
+			if (result.ec != std::errc())
+				return false;
+			current = result.ptr;
+			return true;
+		}
+	};
+
+	// Converts a 1-based or negative (relative) OBJ index into a 0-based one, or -1 if absent/invalid.
+	int64_t ResolveObjIndex(int64_t index, size_t count)
+	{
+		if (index > 0 && static_cast<size_t>(index) <= count)
+			return index - 1;
+		if (index < 0 && static_cast<size_t>(-index) <= count)
+			return static_cast<int64_t>(count) + index;
+		return -1;
+	}
+}
+
+void ConvertObjToMesh(const std::string& objPath, const std::string& meshPath)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	IO::MappedFile obj(objPath);
+	ObjCursor cursor{ static_cast<const char*>(obj.GetData()), static_cast<const char*>(obj.GetData()) + obj.GetSize() };
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> colors;
+	std::vector<glm::vec3> normals;
+	// Position and normal index of every triangle corner.
+	std::vector<std::pair<int64_t, int64_t>> corners;
+	std::vector<std::pair<int64_t, int64_t>> polygon;
+	bool hasColors = false;
+
+	while (cursor.current < cursor.end)
+	{
+		cursor.SkipSpaces();
+		if (cursor.end - cursor.current >= 2 && cursor.current[0] == 'v' && cursor.current[1] == ' ')
+		{
+			cursor.current += 2;
+			glm::vec3 position(0.0f), color(1.0f);
+			cursor.ReadFloat(position.x);
+			cursor.ReadFloat(position.y);
+			cursor.ReadFloat(position.z);
+			if (cursor.ReadFloat(color.r) && cursor.ReadFloat(color.g) && cursor.ReadFloat(color.b))
+				hasColors = true;
+			positions.push_back(position);
+			colors.push_back(color);
+		}
+		else if (cursor.end - cursor.current >= 3 && cursor.current[0] == 'v' && cursor.current[1] == 'n' &&
+			cursor.current[2] == ' ')
+		{
+			cursor.current += 3;
+			glm::vec3 normal(0.0f);
+			cursor.ReadFloat(normal.x);
+			cursor.ReadFloat(normal.y);
+			cursor.ReadFloat(normal.z);
+			normals.push_back(normal);
+		}
+		else if (cursor.end - cursor.current >= 2 && cursor.current[0] == 'f' && cursor.current[1] == ' ')
+		{
+			cursor.current += 2;
+			polygon.clear();
+			while (!cursor.AtLineEnd())
+			{
+				int64_t position = 0, texcoord = 0, normal = 0;
+				if (!cursor.ReadInt(position))
+					break;
+				if (cursor.current < cursor.end && *cursor.current == '/')
+				{
+					cursor.current++;
+					cursor.ReadInt(texcoord);
+					if (cursor.current < cursor.end && *cursor.current == '/')
+					{
+						cursor.current++;
+						cursor.ReadInt(normal);
+					}
+				}
+				polygon.emplace_back(ResolveObjIndex(position, positions.size()), ResolveObjIndex(normal, normals.size()));
+			}
+
+			for (size_t i = 2; i < polygon.size(); i++)
+			{
+				if (polygon[0].first < 0 || polygon[i - 1].first < 0 || polygon[i].first < 0)
+					continue;
+				corners.push_back(polygon[0]);
+				corners.push_back(polygon[i - 1]);
+				corners.push_back(polygon[i]);
+			}
+		}
+		cursor.NextLine();
+	}
+
+	// Without normals in the file, smooth ones are accumulated from the area-weighted face normals.
+	bool generateNormals = normals.empty();
+	if (generateNormals)
+	{
+		normals.assign(positions.size(), glm::vec3(0.0f));
+		for (size_t i = 0; i < corners.size(); i += 3)
+		{
+			glm::vec3 a = positions[corners[i].first];
+			glm::vec3 b = positions[corners[i + 1].first];
+			glm::vec3 c = positions[corners[i + 2].first];
+			glm::vec3 faceNormal = glm::cross(b - a, c - a);
+			for (size_t j = 0; j < 3; j++)
+				normals[corners[i + j].first] += faceNormal;
+		}
+		for (auto& corner : corners)
+			corner.second = corner.first;
+	}
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	indices.reserve(corners.size());
+	std::unordered_map<uint64_t, uint32_t> uniqueVertices;
+	uniqueVertices.reserve(positions.size());
+	for (const auto& corner : corners)
+	{
+		uint64_t key = (static_cast<uint64_t>(corner.first) << 32) | static_cast<uint32_t>(corner.second);
+		auto [it, inserted] = uniqueVertices.emplace(key, static_cast<uint32_t>(vertices.size()));
+		if (inserted)
+		{
+			Vertex vertex{};
+			vertex.pos = positions[corner.first];
+			if (hasColors)
+			{
+				vertex.color = colors[corner.first];
+			}
+			else
+			{
+				glm::vec3 normal = corner.second >= 0 ? normals[corner.second] : glm::vec3(0.0f, 0.0f, 1.0f);
+				float length = glm::length(normal);
+				vertex.color = length > 0.0f ? normal / length * 0.5f + 0.5f : glm::vec3(1.0f);
+			}
+			vertices.push_back(vertex);
+		}
+		indices.push_back(it->second);
+	}
+
+	MeshOptimizationStats optimization = OptimizeMesh(vertices, indices);
+	LogMeshOptimization(optimization);
+
+	WriteMeshFile(meshPath, vertices, indices);
+	spdlog::info("Converted {} to {}: {} vertices, {} triangles{} in {:.1f} ms", objPath, meshPath, vertices.size(),
+		indices.size() / 3, generateNormals ? " (generated normals)" : "",
+		std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+
+struct Vertex;
+
+// On-disk layout of a .vmesh file: this header, then vertexCount vertices of vertexStride bytes at
+// vertexOffset, then indexCount indices of indexSize bytes at indexOffset. Both arrays are stored
+// exactly as the GPU consumes them, so loading is a straight copy into the staging ring.
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t vertexStride;
+	uint32_t indexCount;
+	uint32_t indexSize;
+	float boundsMin[3];
+	float boundsMax[3];
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+};
+
+// A memory-mapped .vmesh file.
+class MeshFile
+{
+public:
+	void Open(const std::string& path);
+	void Close();
+	bool IsOpen() const { return m_header != nullptr; }
+
+	const MeshFileHeader& GetHeader() const { return *m_header; }
+	const void* GetVertices() const;
+	VkDeviceSize GetVertexBytes() const;
+	const void* GetIndices() const;
+	VkDeviceSize GetIndexBytes() const;
+	VkIndexType GetIndexType() const;
+
+private:
+	IO::MappedFile m_file;
+	const MeshFileHeader* m_header = nullptr;
+};
+
+// Writes vertices and indices as a .vmesh file, using 16-bit indices when every vertex can be
+// addressed with them.
+void WriteMeshFile(const std::string& path, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+// Converts the positions, normals and faces of a Wavefront OBJ file into a .vmesh file. Polygons are
+// triangulated as fans; vertex colors come from the optional "v x y z r g b" extension, otherwise
+// from the (generated if missing) normals.
+void ConvertObjToMesh(const std::string& objPath, const std::string& meshPath);
@@ -0,0 +1,357 @@
+#include "MeshOptimizer.hpp"
+#include "VulkanTutorial.hpp"
+
+#include <numeric>
+#include <unordered_map>
+
+// LRU cache the Forsyth scores model; larger than real caches so the order degrades gracefully on all of them.
+static const uint32_t FORSYTH_CACHE_SIZE = 32;
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	// A vertex is in the FIFO while fewer than cacheSize misses happened since it was last loaded.
+	std::vector<uint32_t> loadedAt(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32_t misses = 0;
+	size_t uniqueVertices = 0;
+	for (uint32_t index : indices)
+	{
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			uniqueVertices++;
+		}
+		else if (misses - loadedAt[index] < cacheSize)
+		{
+			continue;
+		}
+		loadedAt[index] = ++misses;
+	}
+
+	VertexCacheStats stats;
+	if (!indices.empty())
+	{
+		stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+		stats.atvr = static_cast<float>(misses) / static_cast<float>(uniqueVertices);
+	}
+	return stats;
+}
+
+void DeduplicateVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	struct VertexHash
+	{
+		const std::vector<Vertex>* vertices;
+		size_t operator()(uint32_t index) const
+		{
+			// FNV-1a over the vertex bytes.
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&(*vertices)[index]);
+			uint64_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < sizeof(Vertex); i++)
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			return static_cast<size_t>(hash);
+		}
+	};
+	struct VertexEqual
+	{
+		const std::vector<Vertex>* vertices;
+		bool operator()(uint32_t a, uint32_t b) const
+		{
+			return memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(Vertex)) == 0;
+		}
+	};
+
+	std::unordered_map<uint32_t, uint32_t, VertexHash, VertexEqual> unique(vertices.size(),
+		VertexHash{ &vertices }, VertexEqual{ &vertices });
+	std::vector<uint32_t> remap(vertices.size());
+	uint32_t uniqueCount = 0;
+	for (uint32_t i = 0; i < vertices.size(); i++)
+	{
+		auto [it, inserted] = unique.emplace(i, uniqueCount);
+		if (inserted)
+			uniqueCount++;
+		remap[i] = it->second;
+	}
+	if (uniqueCount == vertices.size())
+		return;
+
+	// Survivors keep their relative order, so each moves to an index no greater than its own.
+	for (uint32_t i = 0; i < vertices.size(); i++)
+		vertices[remap[i]] = vertices[i];
+	vertices.resize(uniqueCount);
+	for (uint32_t& index : indices)
+		index = remap[index];
+}
+
+static float ForsythVertexScore(int32_t cachePosition, uint32_t liveTriangles)
+{
+	if (liveTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The last triangle's vertices score the same, it does not matter which of them is reused.
+		if (cachePosition < 3)
+			score = 0.75f;
+		else
+			score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+	}
+	// Vertices with few triangles left are finished first, so they stop occupying the cache.
+	return score + 2.0f / std::sqrt(static_cast<float>(liveTriangles));
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Triangles using each vertex; the first liveTriangles[v] entries are the ones not emitted yet.
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (uint32_t index : indices)
+		liveTriangles[index]++;
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t i = 0; i < indices.size(); i++)
+			adjacency[fill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<int32_t> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScore[v] = ForsythVertexScore(-1, liveTriangles[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	size_t best = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		if (triangleScore[t] > triangleScore[best])
+			best = t;
+	}
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	std::vector<uint32_t> cache, nextCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+	size_t scanCursor = 0;
+	while (result.size() < indices.size())
+	{
+		if (best == SIZE_MAX)
+		{
+			// Nothing in the cache has triangles left: continue with the next one in input order.
+			while (emitted[scanCursor])
+				scanCursor++;
+			best = scanCursor;
+		}
+
+		const uint32_t* triangle = &indices[best * 3];
+		emitted[best] = true;
+		nextCache.clear();
+		for (uint32_t j = 0; j < 3; j++)
+		{
+			uint32_t v = triangle[j];
+			result.push_back(v);
+
+			uint32_t* live = &adjacency[adjacencyOffsets[v]];
+			uint32_t* last = live + --liveTriangles[v];
+			*std::find(live, last + 1, static_cast<uint32_t>(best)) = *last;
+
+			if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+				nextCache.push_back(v);
+		}
+		for (uint32_t v : cache)
+		{
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				nextCache.push_back(v);
+		}
+
+		// Vertices pushed out of the cache are rescored too, then dropped.
+		for (uint32_t i = 0; i < nextCache.size(); i++)
+		{
+			uint32_t v = nextCache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+			vertexScore[v] = ForsythVertexScore(cachePosition[v], liveTriangles[v]);
+		}
+
+		best = SIZE_MAX;
+		float bestScore = -std::numeric_limits<float>::max();
+		for (uint32_t v : nextCache)
+		{
+			for (uint32_t k = 0; k < liveTriangles[v]; k++)
+			{
+				uint32_t t = adjacency[adjacencyOffsets[v] + k];
+				float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+					vertexScore[indices[t * 3 + 2]];
+				triangleScore[t] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+
+		if (nextCache.size() > FORSYTH_CACHE_SIZE)
+			nextCache.resize(FORSYTH_CACHE_SIZE);
+		std::swap(cache, nextCache);
+	}
+	indices.swap(result);
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Same FIFO as AnalyzeVertexCache; a vertex loaded before cacheBase counts as evicted, which resets the cache.
+	std::vector<uint32_t> loadedAt(vertices.size(), 0);
+	uint32_t missCount = 0;
+	uint32_t cacheBase = 0;
+	auto simulate = [&](size_t t)
+	{
+		uint32_t triangleMisses = 0;
+		for (size_t j = 0; j < 3; j++)
+		{
+			uint32_t index = indices[t * 3 + j];
+			if (loadedAt[index] > cacheBase && missCount - loadedAt[index] < VERTEX_CACHE_ANALYSIS_SIZE)
+				continue;
+			loadedAt[index] = ++missCount;
+			triangleMisses++;
+		}
+		return triangleMisses;
+	};
+
+	// Hard boundaries are where the cache has nothing to offer, so reordering there is free.
+	std::vector<size_t> hardClusters;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if (simulate(t) == 3)
+			hardClusters.push_back(t);
+	}
+	if (hardClusters.empty() || hardClusters[0] != 0)
+		hardClusters.insert(hardClusters.begin(), 0);
+	hardClusters.push_back(triangleCount);
+
+	// Each hard cluster is split further wherever the piece so far is within threshold of the cluster's ACMR.
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hardClusters.size(); h++)
+	{
+		size_t start = hardClusters[h], end = hardClusters[h + 1];
+		cacheBase = missCount;
+		uint32_t clusterMisses = 0;
+		for (size_t t = start; t < end; t++)
+			clusterMisses += simulate(t);
+		float limit = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+		cacheBase = missCount;
+		size_t pieceStart = start;
+		uint32_t pieceMisses = 0;
+		for (size_t t = start; t < end; t++)
+		{
+			pieceMisses += simulate(t);
+			if (t + 1 < end && static_cast<float>(pieceMisses) <= limit * static_cast<float>(t + 1 - pieceStart))
+			{
+				clusters.push_back(pieceStart);
+				pieceStart = t + 1;
+				pieceMisses = 0;
+				cacheBase = missCount;
+			}
+		}
+		clusters.push_back(pieceStart);
+	}
+	clusters.push_back(triangleCount);
+	size_t clusterCount = clusters.size() - 1;
+
+	// Clusters facing away from the mesh center are drawn first, they are the likeliest to occlude.
+	std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float clusterArea = 0.0f;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const glm::vec3& a = vertices[indices[t * 3]].pos;
+			const glm::vec3& b = vertices[indices[t * 3 + 1]].pos;
+			const glm::vec3& d = vertices[indices[t * 3 + 2]].pos;
+			glm::vec3 normal = glm::cross(b - a, d - a);
+			float area = glm::length(normal);
+			centroids[c] += (a + b + d) * (area / 3.0f);
+			normals[c] += normal;
+			clusterArea += area;
+		}
+		meshCentroid += centroids[c];
+		meshArea += clusterArea;
+		centroids[c] = clusterArea > 0.0f ? centroids[c] / clusterArea : vertices[indices[clusters[c] * 3]].pos;
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float length = glm::length(normals[c]);
+		sortKeys[c] = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+	}
+	std::vector<size_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), size_t(0));
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (size_t c : order)
+		result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	indices.swap(result);
+}
+
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(reordered);
+}
+
+MeshOptimizationStats OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	MeshOptimizationStats stats;
+	stats.verticesBefore = vertices.size();
+	stats.before = AnalyzeVertexCache(indices, vertices.size());
+
+	DeduplicateVertices(vertices, indices);
+	OptimizeVertexCache(indices, vertices.size());
+	OptimizeOverdraw(indices, vertices);
+	OptimizeVertexFetch(vertices, indices);
+
+	stats.verticesAfter = vertices.size();
+	stats.after = AnalyzeVertexCache(indices, vertices.size());
+	stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return stats;
+}
+
+void LogMeshOptimization(const MeshOptimizationStats& stats)
+{
+	spdlog::info("Optimized mesh in {:.1f} ms: {} -> {} vertices, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+		stats.milliseconds, stats.verticesBefore, stats.verticesAfter, stats.before.acmr, stats.after.acmr,
+		stats.before.atvr, stats.after.atvr);
+}
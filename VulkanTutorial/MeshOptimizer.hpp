@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+
+// Simulated FIFO post-transform cache size used to measure index orders.
+const uint32_t VERTEX_CACHE_ANALYSIS_SIZE = 16;
+
+// Average cache miss ratio (transformed vertices per triangle, 0.5 to 3) and average transform to
+// vertex ratio (transformed vertices per referenced vertex, 1 is ideal).
+struct VertexCacheStats
+{
+	float acmr = 0.0f;
+	float atvr = 0.0f;
+};
+
+struct MeshOptimizationStats
+{
+	size_t verticesBefore = 0;
+	size_t verticesAfter = 0;
+	VertexCacheStats before;
+	VertexCacheStats after;
+	double milliseconds = 0.0;
+};
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+	uint32_t cacheSize = VERTEX_CACHE_ANALYSIS_SIZE);
+
+// Merges bitwise identical vertices.
+void DeduplicateVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+// Reorders triangles for post-transform cache hits (Forsyth, "Linear-Speed Vertex Cache Optimisation").
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+// Splits the triangle order into clusters where the cache allows it and draws outward-facing clusters
+// first (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"). threshold
+// bounds the ACMR the split may cost, as a factor of the input's.
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+// Renumbers vertices in first-use order, dropping unreferenced ones.
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Runs every stage above in order and measures the cache before and after.
+MeshOptimizationStats OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+void LogMeshOptimization(const MeshOptimizationStats& stats);
@@ -0,0 +1,269 @@
+#include "MeshSimplifier.hpp"
+#include "MeshOptimizer.hpp"
+#include "VulkanTutorial.hpp"
+
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+	// Sum of squared distances to a set of planes, weighted by the area of the triangles they came from.
+	struct Quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+		double b0 = 0, b1 = 0, b2 = 0, c = 0;
+		double weight = 0;
+
+		void AddPlane(const glm::dvec3& n, double d, double w)
+		{
+			a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+			a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+			b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+			c += w * d * d;
+			weight += w;
+		}
+
+		void Add(const Quadric& other)
+		{
+			a00 += other.a00; a01 += other.a01; a02 += other.a02;
+			a11 += other.a11; a12 += other.a12; a22 += other.a22;
+			b0 += other.b0; b1 += other.b1; b2 += other.b2;
+			c += other.c;
+			weight += other.weight;
+		}
+
+		// Mean squared distance from p to the planes.
+		double Evaluate(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double ax = a00 * x + a01 * y + a02 * z;
+			double ay = a01 * x + a11 * y + a12 * z;
+			double az = a02 * x + a12 * y + a22 * z;
+			double value = x * ax + y * ay + z * az + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			return weight > 0.0 ? std::max(value, 0.0) / weight : 0.0;
+		}
+	};
+
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const
+		{
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			uint64_t hash = bits[0];
+			hash = hash * 0x9E3779B97F4A7C15ull ^ bits[1];
+			hash = hash * 0x9E3779B97F4A7C15ull ^ bits[2];
+			return static_cast<size_t>(hash ^ (hash >> 29));
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+}
+
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	size_t targetIndexCount, float maxError, float* resultError)
+{
+	size_t vertexCount = vertices.size();
+
+	// Collapses work on positions: vertices that only differ in color share the first one's index.
+	std::vector<uint32_t> weld(vertexCount);
+	{
+		std::unordered_map<glm::vec3, uint32_t, PositionHash> firstAt;
+		firstAt.reserve(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; v++)
+			weld[v] = firstAt.emplace(vertices[v].pos, v).first->second;
+	}
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		uint32_t a = weld[indices[i]], b = weld[indices[i + 1]], c = weld[indices[i + 2]];
+		if (a != b && b != c && a != c)
+			result.insert(result.end(), { a, b, c });
+	}
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		glm::dvec3 p0 = vertices[result[i]].pos, p1 = vertices[result[i + 1]].pos, p2 = vertices[result[i + 2]].pos;
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double area = glm::length(normal);
+		if (area == 0.0)
+			continue;
+		normal /= area;
+		double d = -glm::dot(normal, p0);
+		for (size_t j = 0; j < 3; j++)
+			quadrics[result[i + j]].AddPlane(normal, d, area);
+	}
+
+	// Vertices on border or non-manifold edges are locked, so open boundaries keep their outline.
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::unordered_map<uint64_t, uint32_t> edgeUses;
+		edgeUses.reserve(result.size());
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			uint32_t a = result[i], b = result[i % 3 == 2 ? i - 2 : i + 1];
+			edgeUses[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)]++;
+		}
+		for (const auto& [edge, uses] : edgeUses)
+		{
+			if (uses != 2)
+			{
+				locked[static_cast<uint32_t>(edge >> 32)] = true;
+				locked[static_cast<uint32_t>(edge)] = true;
+			}
+		}
+	}
+
+	double maxCost = static_cast<double>(maxError) * maxError;
+	double error = 0.0;
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<uint32_t> collapseTarget(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<Collapse> collapses;
+	while (result.size() > targetIndexCount)
+	{
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (uint32_t index : result)
+			adjacencyOffsets[index + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		adjacency.resize(result.size());
+		{
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (uint32_t i = 0; i < result.size(); i++)
+				adjacency[fill[result[i]]++] = i / 3;
+		}
+
+		// Every directed edge is a candidate, costed by both endpoints' planes at the kept vertex.
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			uint32_t a = result[i], b = result[i % 3 == 2 ? i - 2 : i + 1];
+			for (auto [from, to] : { std::pair(a, b), std::pair(b, a) })
+			{
+				if (locked[from])
+					continue;
+				Quadric combined = quadrics[from];
+				combined.Add(quadrics[to]);
+				collapses.push_back({ from, to, combined.Evaluate(vertices[to].pos) });
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		// Cheapest first, with the neighborhood of each collapse frozen for the rest of the pass so the
+		// flip test stays valid. A collapse removes about two triangles.
+		std::iota(collapseTarget.begin(), collapseTarget.end(), 0u);
+		std::fill(touched.begin(), touched.end(), false);
+		size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+		size_t trianglesRemoved = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.cost > maxCost || trianglesRemoved >= trianglesToRemove)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			// Reject collapses that would turn a surviving triangle over or make it degenerate.
+			bool flips = false;
+			const glm::vec3& target = vertices[collapse.to].pos;
+			for (uint32_t k = adjacencyOffsets[collapse.from]; k < adjacencyOffsets[collapse.from + 1] && !flips; k++)
+			{
+				const uint32_t* triangle = &result[adjacency[k] * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+					continue;
+				glm::vec3 p[3], q[3];
+				for (int j = 0; j < 3; j++)
+				{
+					p[j] = vertices[triangle[j]].pos;
+					q[j] = triangle[j] == collapse.from ? target : p[j];
+				}
+				glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+				flips = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+			}
+			if (flips)
+				continue;
+
+			for (uint32_t k = adjacencyOffsets[collapse.from]; k < adjacencyOffsets[collapse.from + 1]; k++)
+			{
+				const uint32_t* triangle = &result[adjacency[k] * 3];
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+					trianglesRemoved++;
+			}
+			collapseTarget[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			error = std::max(error, collapse.cost);
+		}
+		if (trianglesRemoved == 0)
+			break;
+
+		size_t kept = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t a = collapseTarget[result[i]], b = collapseTarget[result[i + 1]], c = collapseTarget[result[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			result[kept++] = a;
+			result[kept++] = b;
+			result[kept++] = c;
+		}
+		result.resize(kept);
+	}
+
+	if (resultError)
+		*resultError = static_cast<float>(std::sqrt(error));
+	return result;
+}
+
+std::vector<MeshLod> BuildLodChain(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t lodCount)
+{
+	std::vector<MeshLod> lods = { { 0, static_cast<uint32_t>(indices.size()), 0.0f } };
+	std::vector<uint32_t> source(indices);
+	lodCount = std::min(lodCount, MAX_MESH_LODS);
+	for (uint32_t level = 1; level < lodCount; level++)
+	{
+		// Each level simplifies the one before, so their errors add up.
+		float error = 0.0f;
+		std::vector<uint32_t> simplified = SimplifyMesh(vertices, source, source.size() / 6 * 3,
+			std::numeric_limits<float>::max(), &error);
+		if (simplified.empty() || simplified.size() > source.size() * 9 / 10)
+			break;
+
+		OptimizeVertexCache(simplified, vertices.size());
+		lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()),
+			lods.back().error + error });
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		source = std::move(simplified);
+	}
+	return lods;
+}
+
+uint32_t SelectLod(const std::vector<MeshLod>& lods, const glm::mat4& modelViewProj, const glm::vec4& boundingSphere,
+	const glm::vec2& viewportHalfSize, float thresholdPixels)
+{
+	glm::mat4 rows = glm::transpose(modelViewProj);
+	glm::vec3 center(boundingSphere);
+	// Clip w is view depth; a sphere that reaches the camera plane always gets full detail.
+	float depth = glm::dot(glm::vec3(rows[3]), center) + rows[3].w - boundingSphere.w * glm::length(glm::vec3(rows[3]));
+	if (depth <= 0.0f)
+		return 0;
+
+	float pixelsPerUnit = std::max(glm::length(glm::vec3(rows[0])) * viewportHalfSize.x,
+		glm::length(glm::vec3(rows[1])) * viewportHalfSize.y) / depth;
+	uint32_t lod = 0;
+	for (uint32_t i = 1; i < lods.size(); i++)
+	{
+		if (lods[i].error * pixelsPerUnit <= thresholdPixels)
+			lod = i;
+	}
+	return lod;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+struct Vertex;
+
+// LOD levels a mesh can have, including the full-resolution one. Matches the cull shader's tables.
+const uint32_t MAX_MESH_LODS = 4;
+
+// A range of the shared index buffer and its geometric error in mesh units, relative to LOD 0.
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+};
+
+// Quadric error edge collapse (Garland and Heckbert) down to targetIndexCount indices or until the next
+// collapse would exceed maxError. Vertices are collapsed onto existing neighbors, so the result indexes
+// the same vertex array. Border vertices stay put, which keeps open meshes from shrinking.
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	size_t targetIndexCount, float maxError = std::numeric_limits<float>::max(), float* resultError = nullptr);
+
+// Appends up to lodCount - 1 levels to indices, each with about half the triangles of the one before,
+// and returns every level including the original. Stops early once simplification stalls.
+std::vector<MeshLod> BuildLodChain(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+	uint32_t lodCount = MAX_MESH_LODS);
+
+// Picks the coarsest LOD whose error projects to at most thresholdPixels, from where the bounding sphere
+// comes closest to the camera. res/cull.glsl implements the same selection.
+uint32_t SelectLod(const std::vector<MeshLod>& lods, const glm::mat4& modelViewProj, const glm::vec4& boundingSphere,
+	const glm::vec2& viewportHalfSize, float thresholdPixels);
@@ -0,0 +1,139 @@
+#include "PipelineCache.hpp"
+#include "VulkanTutorial.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+static const uint32_t CACHE_FILE_MAGIC = 0x43505456; // "VTPC"
+static const uint32_t CACHE_FILE_VERSION = 1;
+
+struct CacheFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t dataSize;
+	uint64_t checksum;
+};
+
+static uint64_t Fnv1a(const char* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+void PipelineCache::Init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& path)
+{
+	m_device = device;
+	m_path = path;
+	vkGetPhysicalDeviceProperties(physicalDevice, &m_properties);
+
+	std::vector<char> data;
+	if (!m_path.empty())
+		data = Load();
+	m_loaded = !data.empty();
+
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	VK_CHECKERROR(
+		vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_pipelineCache),
+		"Failed to create pipeline cache"
+	)
+	spdlog::info("Created pipeline cache ({}, {} bytes)", m_loaded ? "warm" : "cold", data.size());
+}
+
+void PipelineCache::Save() const
+{
+	if (m_path.empty() || m_pipelineCache == VK_NULL_HANDLE)
+		return;
+
+	size_t size = 0;
+	vkGetPipelineCacheData(m_device, m_pipelineCache, &size, nullptr);
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(m_device, m_pipelineCache, &size, data.data()) != VK_SUCCESS)
+	{
+		spdlog::warn("Failed to read pipeline cache data, not saving");
+		return;
+	}
+
+	CacheFileHeader header{ CACHE_FILE_MAGIC, CACHE_FILE_VERSION, size, Fnv1a(data.data(), size) };
+
+	// Write next to the target and rename, so a crash mid-write never leaves a half-written cache behind.
+	std::string tempPath = m_path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			spdlog::warn("Failed to open {} for writing", tempPath);
+			return;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data.data(), size);
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, m_path, error);
+	if (error)
+	{
+		spdlog::warn("Failed to save pipeline cache to {}: {}", m_path, error.message());
+		return;
+	}
+	spdlog::info("Saved pipeline cache to {} ({} bytes)", m_path, size);
+}
+
+void PipelineCache::Destroy()
+{
+	vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+	m_pipelineCache = VK_NULL_HANDLE;
+}
+
+std::vector<char> PipelineCache::Load() const
+{
+	if (!std::filesystem::exists(m_path))
+		return {};
+
+	std::vector<char> file = IO::ReadFile(m_path);
+	std::vector<char> data;
+
+	CacheFileHeader header{};
+	if (file.size() >= sizeof(header))
+	{
+		memcpy(&header, file.data(), sizeof(header));
+		if (header.magic == CACHE_FILE_MAGIC && header.version == CACHE_FILE_VERSION &&
+			header.dataSize == file.size() - sizeof(header) &&
+			header.checksum == Fnv1a(file.data() + sizeof(header), header.dataSize))
+		{
+			data.assign(file.begin() + sizeof(header), file.end());
+		}
+	}
+
+	if (data.empty() || !IsCompatible(data))
+	{
+		spdlog::warn("Discarding corrupt or stale pipeline cache {}", m_path);
+		std::error_code error;
+		std::filesystem::remove(m_path, error);
+		return {};
+	}
+	return data;
+}
+
+bool PipelineCache::IsCompatible(const std::vector<char>& data) const
+{
+	VkPipelineCacheHeaderVersionOne header{};
+	if (data.size() < sizeof(header))
+		return false;
+	memcpy(&header, data.data(), sizeof(header));
+
+	return header.headerSize >= sizeof(header) &&
+		header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		header.vendorID == m_properties.vendorID &&
+		header.deviceID == m_properties.deviceID &&
+		memcmp(header.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
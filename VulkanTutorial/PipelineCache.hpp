@@ -0,0 +1,30 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+
+// VkPipelineCache persisted between runs. The file wraps the driver blob with its size and a
+// checksum, and the blob's own header is checked against the current device, so truncated,
+// corrupt or stale caches (other GPU, other driver version) are thrown away instead of handed
+// to the driver.
+class PipelineCache
+{
+public:
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& path);
+	void Save() const;
+	void Destroy();
+
+	VkPipelineCache Get() const { return m_pipelineCache; }
+	// True when the cache was seeded from a valid file, i.e. this is a warm start.
+	bool WasLoaded() const { return m_loaded; }
+
+private:
+	std::vector<char> Load() const;
+	bool IsCompatible(const std::vector<char>& data) const;
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties m_properties{};
+	VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+	std::string m_path;
+	bool m_loaded = false;
+};
@@ -0,0 +1,392 @@
+#include "PipelineLibrary.hpp"
+#include "VulkanTutorial.hpp"
+#include "SpirvReflection.hpp"
+
+static void HashCombine(size_t& seed, size_t value)
+{
+	seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+size_t PipelineDesc::Hash() const
+{
+	size_t seed = 0;
+	HashCombine(seed, std::hash<std::string>()(vertexShader));
+	HashCombine(seed, std::hash<std::string>()(fragmentShader));
+	HashCombine(seed, static_cast<size_t>(vertexLayout));
+	HashCombine(seed, static_cast<size_t>(vertexEncoding));
+	HashCombine(seed, static_cast<size_t>(topology));
+	HashCombine(seed, static_cast<size_t>(polygonMode));
+	HashCombine(seed, static_cast<size_t>(cullMode));
+	HashCombine(seed, static_cast<size_t>(frontFace));
+	HashCombine(seed, static_cast<size_t>(blendEnable));
+	HashCombine(seed, std::hash<VkRenderPass>()(renderPass));
+	HashCombine(seed, static_cast<size_t>(subpass));
+	HashCombine(seed, std::hash<VkPipelineLayout>()(layout));
+	return seed;
+}
+
+static void DestroyIfCompiled(VkDevice device, const std::shared_future<VkPipeline>& pipeline)
+{
+	try
+	{
+		vkDestroyPipeline(device, pipeline.get(), nullptr);
+	}
+	catch (const std::exception&)
+	{
+		// The compile failed and already reported its error when the pipeline was requested.
+	}
+}
+
+void PipelineLibrary::Init(VkDevice device, VkPipelineCache pipelineCache, JobSystem& jobs, LayoutCache& layouts,
+	DeletionQueue& deletionQueue)
+{
+	m_device = device;
+	m_pipelineCache = pipelineCache;
+	m_jobs = &jobs;
+	m_layouts = &layouts;
+	m_deletionQueue = &deletionQueue;
+}
+
+void PipelineLibrary::Destroy()
+{
+	// Compiles still running on workers would otherwise hand back pipelines nobody destroys.
+	m_jobs->WaitIdle();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& [desc, pipeline] : m_pipelines)
+		DestroyIfCompiled(m_device, pipeline);
+	for (auto& [desc, pipeline] : m_replacements)
+		DestroyIfCompiled(m_device, pipeline);
+	for (auto& pipeline : m_abandoned)
+		DestroyIfCompiled(m_device, pipeline);
+	m_pipelines.clear();
+	m_replacements.clear();
+	m_abandoned.clear();
+	m_shaderCode.clear();
+	spdlog::info("Destroyed pipeline library, {:.2f} ms spent compiling", GetCompileMilliseconds());
+}
+
+VkPipeline PipelineLibrary::Request(const PipelineDesc& desc)
+{
+	std::shared_future<VkPipeline> pipeline = FindOrCompile(desc);
+	if (pipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return VK_NULL_HANDLE;
+	return pipeline.get();
+}
+
+VkPipeline PipelineLibrary::RequestBlocking(const PipelineDesc& desc)
+{
+	return FindOrCompile(desc).get();
+}
+
+void PipelineLibrary::ReloadShader(const std::string& path, std::vector<char> code)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_shaderMutex);
+		m_shaderCode[path] = std::move(code);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& [desc, pipeline] : m_pipelines)
+	{
+		if (desc.vertexShader != path && desc.fragmentShader != path)
+			continue;
+		// A recompile still running for an older version is dropped once it finishes.
+		auto replaced = m_replacements.find(desc);
+		if (replaced != m_replacements.end())
+		{
+			m_abandoned.push_back(replaced->second);
+			m_replacements.erase(replaced);
+		}
+		m_replacements.emplace(desc, StartCompile(desc));
+	}
+}
+
+bool PipelineLibrary::BeginFrame()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	// No frame ever used these, so they can go as soon as their compile is done.
+	std::erase_if(m_abandoned, [this](const std::shared_future<VkPipeline>& pipeline)
+	{
+		if (pipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+		DestroyIfCompiled(m_device, pipeline);
+		return true;
+	});
+
+	bool changed = false;
+	for (auto replacement = m_replacements.begin(); replacement != m_replacements.end();)
+	{
+		if (replacement->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			++replacement;
+			continue;
+		}
+		try
+		{
+			replacement->second.get();
+		}
+		catch (const std::exception& e)
+		{
+			spdlog::error("Keeping the previous pipeline: {}", e.what());
+			replacement = m_replacements.erase(replacement);
+			continue;
+		}
+
+		// Frames still in flight may use the old pipeline.
+		std::shared_future<VkPipeline>& current = m_pipelines[replacement->first];
+		if (current.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			try
+			{
+				m_deletionQueue->PushPipeline(current.get());
+			}
+			catch (const std::exception&)
+			{
+				// The old version never compiled, so there is nothing to retire.
+			}
+		}
+		else
+		{
+			m_abandoned.push_back(current);
+		}
+		current = replacement->second;
+		replacement = m_replacements.erase(replacement);
+		changed = true;
+	}
+	return changed;
+}
+
+size_t PipelineLibrary::GetPipelineCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pipelines.size();
+}
+
+std::shared_future<VkPipeline> PipelineLibrary::FindOrCompile(const PipelineDesc& desc)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto existing = m_pipelines.find(desc);
+	if (existing != m_pipelines.end())
+		return existing->second;
+
+	std::shared_future<VkPipeline> pipeline = StartCompile(desc);
+	m_pipelines.emplace(desc, pipeline);
+	return pipeline;
+}
+
+std::shared_future<VkPipeline> PipelineLibrary::StartCompile(const PipelineDesc& desc)
+{
+	auto promise = std::make_shared<std::promise<VkPipeline>>();
+	std::shared_future<VkPipeline> pipeline = promise->get_future().share();
+	m_jobs->Submit([this, desc, promise]
+	{
+		try
+		{
+			promise->set_value(Compile(desc));
+		}
+		catch (...)
+		{
+			promise->set_exception(std::current_exception());
+		}
+	});
+	return pipeline;
+}
+
+std::vector<char> PipelineLibrary::GetShaderCode(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(m_shaderMutex);
+	auto cached = m_shaderCode.find(path);
+	if (cached == m_shaderCode.end())
+		cached = m_shaderCode.emplace(path, IO::ReadFile(path)).first;
+	return cached->second;
+}
+
+VkShaderModule PipelineLibrary::CreateShaderModule(const std::string& path, const std::vector<char>& code)
+{
+	VkShaderModuleCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = code.size();
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	VkShaderModule shaderModule;
+	VK_CHECKERROR(
+		vkCreateShaderModule(m_device, &createInfo, nullptr, &shaderModule),
+		"Failed to create Shader Module " + path
+	)
+	return shaderModule;
+}
+
+VkPipeline PipelineLibrary::Compile(const PipelineDesc& desc)
+{
+	auto compileStart = std::chrono::high_resolution_clock::now();
+
+	std::vector<char> vertexCode = GetShaderCode(desc.vertexShader);
+	std::vector<char> fragmentCode = GetShaderCode(desc.fragmentShader);
+	ShaderReflection vertexReflection = ReflectSpirv(vertexCode.data(), vertexCode.size());
+	ShaderReflection fragmentReflection = ReflectSpirv(fragmentCode.data(), fragmentCode.size());
+	// The layout is shared and was reflected from the shaders at startup; a reloaded shader must still fit it.
+	m_layouts->CheckCompatible(desc.layout, vertexReflection, desc.vertexShader);
+	m_layouts->CheckCompatible(desc.layout, fragmentReflection, desc.fragmentShader);
+
+	// Every input the vertex shader reads is fed from the encoding's field at that location in binding 0,
+	// or for instanced layouts from the instance data at the locations after the fields.
+	VkVertexInputBindingDescription vertexBinding{};
+	std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+	switch (desc.vertexEncoding)
+	{
+	case VertexEncoding::Full:
+	{
+		auto attributes = FullVertexFormat::GetAttributeDescriptions();
+		vertexBinding = FullVertexFormat::GetBindingDescription();
+		vertexAttributes.assign(attributes.begin(), attributes.end());
+		break;
+	}
+	case VertexEncoding::Packed:
+	{
+		auto attributes = PackedVertexFormat::GetAttributeDescriptions();
+		vertexBinding = PackedVertexFormat::GetBindingDescription();
+		vertexAttributes.assign(attributes.begin(), attributes.end());
+		break;
+	}
+	}
+	auto instanceAttributes = InstanceData::GetAttributeDescriptions(static_cast<uint32_t>(vertexAttributes.size()));
+
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+	bool readsVertices = false;
+	bool readsInstances = false;
+	for (const ReflectedInput& input : vertexReflection.inputs)
+	{
+		auto atLocation = [&](const VkVertexInputAttributeDescription& attribute) { return attribute.location == input.location; };
+		auto vertexAttribute = std::find_if(vertexAttributes.begin(), vertexAttributes.end(), atLocation);
+		auto instanceAttribute = std::find_if(instanceAttributes.begin(), instanceAttributes.end(), atLocation);
+		if (vertexAttribute != vertexAttributes.end())
+		{
+			attributeDescriptions.push_back(*vertexAttribute);
+			readsVertices = true;
+		}
+		else if (desc.vertexLayout == VertexLayout::Instanced && instanceAttribute != instanceAttributes.end())
+		{
+			attributeDescriptions.push_back(*instanceAttribute);
+			readsInstances = true;
+		}
+		else
+		{
+			throw std::runtime_error(desc.vertexShader + " reads vertex input location " +
+				std::to_string(input.location) + ", which its vertex layout does not provide");
+		}
+	}
+	if (readsVertices)
+		bindingDescriptions.push_back(vertexBinding);
+	if (readsInstances)
+		bindingDescriptions.push_back(InstanceData::GetBindingDescription());
+
+	VkShaderModule vertexShaderModule = CreateShaderModule(desc.vertexShader, vertexCode);
+	VkShaderModule fragmentShaderModule = CreateShaderModule(desc.fragmentShader, fragmentCode);
+
+	VkPipelineShaderStageCreateInfo vertexShaderStageCreateInfo{};
+	vertexShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertexShaderStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertexShaderStageCreateInfo.module = vertexShaderModule;
+	vertexShaderStageCreateInfo.pName = "main";
+
+	VkPipelineShaderStageCreateInfo fragmentShaderStageCreateInfo{};
+	fragmentShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragmentShaderStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragmentShaderStageCreateInfo.module = fragmentShaderModule;
+	fragmentShaderStageCreateInfo.pName = "main";
+
+	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderStageCreateInfo, fragmentShaderStageCreateInfo };
+
+	std::vector<VkDynamicState> dynamicStates = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = desc.topology;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = desc.polygonMode;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = desc.cullMode;
+	rasterizer.frontFace = desc.frontFace;
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
+		| VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = desc.blendEnable ? VK_TRUE : VK_FALSE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.logicOp = VK_LOGIC_OP_COPY;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = nullptr;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = desc.layout;
+	pipelineInfo.renderPass = desc.renderPass;
+	pipelineInfo.subpass = desc.subpass;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	// The pipeline cache is internally synchronized, so workers can compile through it concurrently.
+	VkPipeline pipeline;
+	VkResult result = vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+
+	vkDestroyShaderModule(m_device, fragmentShaderModule, nullptr);
+	vkDestroyShaderModule(m_device, vertexShaderModule, nullptr);
+
+	VK_CHECKERROR(result, "Failed to create Graphics Pipe Line for " + desc.vertexShader)
+
+	auto elapsed = std::chrono::high_resolution_clock::now() - compileStart;
+	m_compileMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+	spdlog::info("Compiled pipeline {:016x} ({} + {})", desc.Hash(), desc.vertexShader, desc.fragmentShader);
+	return pipeline;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "JobSystem.hpp"
+#include "DeletionQueue.hpp"
+#include "LayoutCache.hpp"
+
+// Vertex input layouts the library knows how to describe.
+enum class VertexLayout : uint8_t
+{
+	Standard,
+	// Standard plus a per-instance model matrix in binding 1.
+	Instanced
+};
+
+// How binding 0 stores each vertex.
+enum class VertexEncoding : uint8_t
+{
+	// Vertex, FullVertexFormat.
+	Full,
+	// PackedVertex, PackedVertexFormat.
+	Packed
+};
+
+// Everything that makes one graphics pipeline different from another. Viewport and scissor are
+// always dynamic, so the extent is not part of the key.
+struct PipelineDesc
+{
+	std::string vertexShader = "res/vertex.spv";
+	std::string fragmentShader = "res/fragment.spv";
+	VertexLayout vertexLayout = VertexLayout::Standard;
+	VertexEncoding vertexEncoding = VertexEncoding::Full;
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+	bool blendEnable = false;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	uint32_t subpass = 0;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+
+	size_t Hash() const;
+	bool operator==(const PipelineDesc& other) const = default;
+};
+
+struct PipelineDescHasher
+{
+	size_t operator()(const PipelineDesc& desc) const { return desc.Hash(); }
+};
+
+// Deduplicates pipeline requests by their description and compiles new ones on the job system,
+// so a draw that needs a permutation nobody has asked for yet never waits on the driver.
+class PipelineLibrary
+{
+public:
+	void Init(VkDevice device, VkPipelineCache pipelineCache, JobSystem& jobs, LayoutCache& layouts,
+	          DeletionQueue& deletionQueue);
+	void Destroy();
+
+	// Returns the pipeline if it is ready. Otherwise starts compiling it (once per unique description)
+	// and returns VK_NULL_HANDLE, so the caller can skip or substitute the draw this frame.
+	VkPipeline Request(const PipelineDesc& desc);
+	// Same as Request but waits for the compile, for pipelines that must exist before the first frame.
+	VkPipeline RequestBlocking(const PipelineDesc& desc);
+
+	// Replaces the SPIR-V of a shader path and recompiles every pipeline using it in the background.
+	// The old pipelines keep being returned until BeginFrame swaps the new ones in. A shader whose
+	// descriptors or push constants no longer fit the pipeline's layout fails to compile, so the old
+	// pipeline stays.
+	void ReloadShader(const std::string& path, std::vector<char> code);
+	// Swaps in recompiled pipelines, handing the ones they replace to the deletion queue. Call once per
+	// frame before recording. Returns whether any pipeline changed.
+	bool BeginFrame();
+
+	size_t GetPipelineCount() const;
+	double GetCompileMilliseconds() const { return m_compileMicroseconds.load() / 1000.0; }
+
+private:
+	std::shared_future<VkPipeline> FindOrCompile(const PipelineDesc& desc);
+	std::shared_future<VkPipeline> StartCompile(const PipelineDesc& desc);
+	VkPipeline Compile(const PipelineDesc& desc);
+	std::vector<char> GetShaderCode(const std::string& path);
+	VkShaderModule CreateShaderModule(const std::string& path, const std::vector<char>& code);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+	JobSystem* m_jobs = nullptr;
+	LayoutCache* m_layouts = nullptr;
+	DeletionQueue* m_deletionQueue = nullptr;
+
+	mutable std::mutex m_mutex;
+	std::unordered_map<PipelineDesc, std::shared_future<VkPipeline>, PipelineDescHasher> m_pipelines;
+	// Recompiles started by ReloadShader.
+	std::unordered_map<PipelineDesc, std::shared_future<VkPipeline>, PipelineDescHasher> m_replacements;
+	// Compiles superseded before they were ever used, destroyed once they finish.
+	std::vector<std::shared_future<VkPipeline>> m_abandoned;
+	std::mutex m_shaderMutex;
+	std::unordered_map<std::string, std::vector<char>> m_shaderCode;
+	std::atomic<uint64_t> m_compileMicroseconds = 0;
+};
@@ -0,0 +1,190 @@
+#include "ShaderHotReload.hpp"
+#include "VulkanTutorial.hpp"
+
+#include <filesystem>
+#include <shaderc/shaderc.hpp>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#ifdef _DEBUG
+#pragma comment(lib, "shaderc_combinedd.lib")
+#else
+#pragma comment(lib, "shaderc_combined.lib")
+#endif
+#endif
+
+// How often the stop flag is checked, and modification times polled where inotify is unavailable.
+static const std::chrono::milliseconds WATCH_INTERVAL(100);
+// Editors often save in several writes; changes this close together are compiled once.
+static const std::chrono::milliseconds WATCH_SETTLE_TIME(20);
+
+static int64_t GetLastWriteTime(const std::string& path)
+{
+	std::error_code error;
+	auto time = std::filesystem::last_write_time(path, error);
+	return error ? 0 : static_cast<int64_t>(time.time_since_epoch().count());
+}
+
+void ShaderHotReload::Init()
+{
+	for (WatchedShader& shader : m_shaders)
+		shader.lastWriteTime = GetLastWriteTime(shader.sourcePath);
+
+#ifdef __linux__
+	m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotify < 0)
+	{
+		throw std::runtime_error("Failed to create an inotify instance for shader hot reload");
+	}
+	// Directories rather than files: editors that save by renaming a new file over the old one would
+	// otherwise leave the watch on the deleted inode.
+	std::vector<std::string> directories;
+	for (const WatchedShader& shader : m_shaders)
+	{
+		std::string directory = std::filesystem::path(shader.sourcePath).parent_path().string();
+		if (directory.empty())
+			directory = ".";
+		if (std::find(directories.begin(), directories.end(), directory) != directories.end())
+			continue;
+		directories.push_back(directory);
+		if (inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+		{
+			spdlog::warn("Failed to watch {} for shader changes", directory);
+		}
+	}
+#endif
+
+	m_running = true;
+	m_thread = std::thread(&ShaderHotReload::Run, this);
+	spdlog::info("Watching {} shader sources for changes", m_shaders.size());
+}
+
+void ShaderHotReload::Destroy()
+{
+	m_running = false;
+	if (m_thread.joinable())
+		m_thread.join();
+#ifdef __linux__
+	if (m_inotify >= 0)
+		close(m_inotify);
+	m_inotify = -1;
+#endif
+	m_shaders.clear();
+	m_compiled.clear();
+}
+
+void ShaderHotReload::Watch(const std::string& spirvPath, const std::string& sourcePath, VkShaderStageFlagBits stage)
+{
+	m_shaders.push_back({ spirvPath, sourcePath, stage });
+}
+
+std::vector<ShaderHotReload::CompiledShader> ShaderHotReload::TakeCompiled()
+{
+	std::vector<CompiledShader> compiled;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	compiled.swap(m_compiled);
+	return compiled;
+}
+
+void ShaderHotReload::Run()
+{
+	while (m_running)
+	{
+		for (size_t index : WaitForChanges())
+			Compile(m_shaders[index]);
+	}
+}
+
+std::vector<size_t> ShaderHotReload::WaitForChanges()
+{
+#ifdef __linux__
+	pollfd descriptor{ m_inotify, POLLIN, 0 };
+	if (poll(&descriptor, 1, static_cast<int>(WATCH_INTERVAL.count())) <= 0)
+		return {};
+	std::this_thread::sleep_for(WATCH_SETTLE_TIME);
+	// The events only say which directory changed; the modification times below say which files.
+	alignas(inotify_event) char events[4096];
+	while (read(m_inotify, events, sizeof(events)) > 0)
+	{
+	}
+#else
+	std::this_thread::sleep_for(WATCH_INTERVAL);
+#endif
+
+	std::vector<size_t> changed;
+	for (size_t i = 0; i < m_shaders.size(); i++)
+	{
+		int64_t lastWriteTime = GetLastWriteTime(m_shaders[i].sourcePath);
+		if (lastWriteTime != 0 && lastWriteTime != m_shaders[i].lastWriteTime)
+		{
+			m_shaders[i].lastWriteTime = lastWriteTime;
+			changed.push_back(i);
+		}
+	}
+	return changed;
+}
+
+void ShaderHotReload::Compile(const WatchedShader& shader)
+{
+	auto compileStart = std::chrono::high_resolution_clock::now();
+	std::vector<char> source;
+	try
+	{
+		source = IO::ReadFile(shader.sourcePath);
+	}
+	catch (const std::exception& e)
+	{
+		spdlog::error("Failed to reload {}: {}", shader.sourcePath, e.what());
+		m_failures++;
+		return;
+	}
+
+	shaderc_shader_kind kind = shaderc_glsl_vertex_shader;
+	switch (shader.stage)
+	{
+	case VK_SHADER_STAGE_FRAGMENT_BIT:
+		kind = shaderc_glsl_fragment_shader;
+		break;
+	case VK_SHADER_STAGE_COMPUTE_BIT:
+		kind = shaderc_glsl_compute_shader;
+		break;
+	default:
+		break;
+	}
+
+	// Same settings as res/compile.bat.
+	shaderc::Compiler compiler;
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source.data(), source.size(), kind,
+		shader.sourcePath.c_str(), options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+	{
+		spdlog::error("Failed to compile {}, keeping the previous version:\n{}", shader.sourcePath,
+			result.GetErrorMessage());
+		m_failures++;
+		return;
+	}
+
+	CompiledShader compiled;
+	compiled.spirvPath = shader.spirvPath;
+	compiled.code.assign(reinterpret_cast<const char*>(result.cbegin()), reinterpret_cast<const char*>(result.cend()));
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		// A newer compile of the same shader replaces one that was not taken yet.
+		auto existing = std::find_if(m_compiled.begin(), m_compiled.end(),
+			[&](const CompiledShader& other) { return other.spirvPath == compiled.spirvPath; });
+		if (existing != m_compiled.end())
+			*existing = std::move(compiled);
+		else
+			m_compiled.push_back(std::move(compiled));
+	}
+	m_reloads++;
+	spdlog::info("Recompiled {} in {:.2f} ms", shader.sourcePath, std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - compileStart).count());
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches the GLSL sources of SPIR-V shaders and recompiles the ones that change with libshaderc on a
+// background thread, so edits reach the running program in milliseconds. Changes are picked up with
+// inotify on Linux and by polling modification times elsewhere. Compile errors are logged and leave
+// the previous SPIR-V in use.
+class ShaderHotReload
+{
+public:
+	struct CompiledShader
+	{
+		// The .spv path pipelines know the shader by.
+		std::string spirvPath;
+		std::vector<char> code;
+	};
+
+	void Init();
+	void Destroy();
+
+	// Must be called before Init.
+	void Watch(const std::string& spirvPath, const std::string& sourcePath, VkShaderStageFlagBits stage);
+
+	// Shaders recompiled since the last call, for the caller to swap in at a frame boundary.
+	std::vector<CompiledShader> TakeCompiled();
+
+	uint32_t GetReloadCount() const { return m_reloads.load(); }
+	uint32_t GetFailureCount() const { return m_failures.load(); }
+
+private:
+	struct WatchedShader
+	{
+		std::string spirvPath;
+		std::string sourcePath;
+		VkShaderStageFlagBits stage;
+		int64_t lastWriteTime = 0;
+	};
+
+	void Run();
+	// Blocks until some sources may have changed or the thread is stopping, and returns the changed ones.
+	std::vector<size_t> WaitForChanges();
+	void Compile(const WatchedShader& shader);
+
+	std::vector<WatchedShader> m_shaders;
+	std::thread m_thread;
+	std::atomic<bool> m_running = false;
+	int m_inotify = -1;
+
+	std::mutex m_mutex;
+	std::vector<CompiledShader> m_compiled;
+	std::atomic<uint32_t> m_reloads = 0;
+	std::atomic<uint32_t> m_failures = 0;
+};
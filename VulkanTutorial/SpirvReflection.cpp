@@ -0,0 +1,438 @@
+#include "SpirvReflection.hpp"
+#include "VulkanTutorial.hpp"
+
+#include <unordered_map>
+
+namespace
+{
+	const uint32_t SPIRV_MAGIC = 0x07230203;
+	const uint32_t NONE = UINT32_MAX;
+
+	enum Op : uint32_t
+	{
+		OpEntryPoint = 15,
+		OpTypeBool = 20,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72,
+		OpTypeAccelerationStructureKHR = 5341,
+	};
+
+	enum Decoration : uint32_t
+	{
+		DecorationBlock = 2,
+		DecorationBufferBlock = 3,
+		DecorationArrayStride = 6,
+		DecorationMatrixStride = 7,
+		DecorationBuiltIn = 11,
+		DecorationLocation = 30,
+		DecorationBinding = 33,
+		DecorationDescriptorSet = 34,
+		DecorationOffset = 35,
+	};
+
+	enum StorageClass : uint32_t
+	{
+		StorageUniformConstant = 0,
+		StorageInput = 1,
+		StorageUniform = 2,
+		StoragePushConstant = 9,
+		StorageStorageBuffer = 12,
+	};
+
+	enum Dim : uint32_t
+	{
+		DimBuffer = 5,
+		DimSubpassData = 6,
+	};
+
+	struct Type
+	{
+		uint32_t opcode = 0;
+		// Operands after the result id.
+		std::vector<uint32_t> operands;
+	};
+
+	struct Decorations
+	{
+		uint32_t location = NONE;
+		uint32_t binding = NONE;
+		uint32_t set = NONE;
+		uint32_t arrayStride = 0;
+		bool block = false;
+		bool bufferBlock = false;
+		bool builtIn = false;
+	};
+
+	struct MemberDecorations
+	{
+		uint32_t offset = 0;
+		uint32_t matrixStride = 0;
+		bool builtIn = false;
+	};
+
+	struct Variable
+	{
+		uint32_t id;
+		uint32_t pointerType;
+		uint32_t storageClass;
+	};
+
+	class Module
+	{
+	public:
+		Module(const uint32_t* words, size_t wordCount)
+		{
+			if (wordCount < 5 || words[0] != SPIRV_MAGIC)
+			{
+				throw std::runtime_error("Shader is not a SPIR-V module");
+			}
+			for (size_t i = 5; i < wordCount;)
+			{
+				uint32_t opcode = words[i] & 0xffff;
+				uint32_t length = words[i] >> 16;
+				if (length == 0 || i + length > wordCount)
+				{
+					throw std::runtime_error("Truncated SPIR-V instruction");
+				}
+				Parse(opcode, words + i + 1, length - 1);
+				i += length;
+			}
+			if (!m_hasEntryPoint)
+			{
+				throw std::runtime_error("SPIR-V module has no entry point");
+			}
+		}
+
+		ShaderReflection Reflect() const
+		{
+			ShaderReflection reflection;
+			reflection.stage = m_stage;
+			for (const Variable& variable : m_variables)
+			{
+				const Decorations& decorations = GetDecorations(variable.id);
+				uint32_t type = GetType(variable.pointerType).operands[1];
+				switch (variable.storageClass)
+				{
+				case StorageInput:
+					if (m_stage == VK_SHADER_STAGE_VERTEX_BIT && !decorations.builtIn && !HasBuiltInMembers(type))
+						AddInputs(reflection, decorations.location, type);
+					break;
+				case StoragePushConstant:
+					reflection.pushConstantSize = std::max(reflection.pushConstantSize, GetSize(type, 0));
+					break;
+				case StorageUniformConstant:
+				case StorageUniform:
+				case StorageStorageBuffer:
+					if (decorations.binding != NONE)
+						reflection.bindings.push_back(GetBinding(variable, decorations, type));
+					break;
+				default:
+					break;
+				}
+			}
+			std::sort(reflection.inputs.begin(), reflection.inputs.end(),
+				[](const ReflectedInput& a, const ReflectedInput& b) { return a.location < b.location; });
+			return reflection;
+		}
+
+	private:
+		void Parse(uint32_t opcode, const uint32_t* operands, uint32_t count)
+		{
+			switch (opcode)
+			{
+			case OpEntryPoint:
+				// Modules with several entry points are reflected as their first.
+				if (!m_hasEntryPoint && count >= 1)
+				{
+					m_stage = GetStage(operands[0]);
+					m_hasEntryPoint = true;
+				}
+				break;
+			case OpDecorate:
+				if (count >= 2)
+				{
+					Decorations& decorations = m_decorations[operands[0]];
+					uint32_t value = count >= 3 ? operands[2] : 0;
+					switch (operands[1])
+					{
+					case DecorationBlock: decorations.block = true; break;
+					case DecorationBufferBlock: decorations.bufferBlock = true; break;
+					case DecorationArrayStride: decorations.arrayStride = value; break;
+					case DecorationBuiltIn: decorations.builtIn = true; break;
+					case DecorationLocation: decorations.location = value; break;
+					case DecorationBinding: decorations.binding = value; break;
+					case DecorationDescriptorSet: decorations.set = value; break;
+					default: break;
+					}
+				}
+				break;
+			case OpMemberDecorate:
+				if (count >= 3)
+				{
+					std::vector<MemberDecorations>& members = m_memberDecorations[operands[0]];
+					if (members.size() <= operands[1])
+						members.resize(operands[1] + 1);
+					MemberDecorations& decorations = members[operands[1]];
+					uint32_t value = count >= 4 ? operands[3] : 0;
+					switch (operands[2])
+					{
+					case DecorationOffset: decorations.offset = value; break;
+					case DecorationMatrixStride: decorations.matrixStride = value; break;
+					case DecorationBuiltIn: decorations.builtIn = true; break;
+					default: break;
+					}
+				}
+				break;
+			case OpTypeBool:
+			case OpTypeInt:
+			case OpTypeFloat:
+			case OpTypeVector:
+			case OpTypeMatrix:
+			case OpTypeImage:
+			case OpTypeSampler:
+			case OpTypeSampledImage:
+			case OpTypeArray:
+			case OpTypeRuntimeArray:
+			case OpTypeStruct:
+			case OpTypePointer:
+			case OpTypeAccelerationStructureKHR:
+				if (count >= 1)
+					m_types[operands[0]] = { opcode, std::vector<uint32_t>(operands + 1, operands + count) };
+				break;
+			case OpConstant:
+				if (count >= 3)
+					m_constants[operands[1]] = operands[2];
+				break;
+			case OpVariable:
+				if (count >= 3)
+					m_variables.push_back({ operands[1], operands[0], operands[2] });
+				break;
+			default:
+				break;
+			}
+		}
+
+		static VkShaderStageFlagBits GetStage(uint32_t executionModel)
+		{
+			switch (executionModel)
+			{
+			case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+			case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+			case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+			case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+			case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+			case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+			default:
+				throw std::runtime_error("Unsupported SPIR-V execution model " + std::to_string(executionModel));
+			}
+		}
+
+		const Type& GetType(uint32_t id) const
+		{
+			auto type = m_types.find(id);
+			if (type == m_types.end())
+			{
+				throw std::runtime_error("SPIR-V references undeclared type %" + std::to_string(id));
+			}
+			return type->second;
+		}
+
+		const Decorations& GetDecorations(uint32_t id) const
+		{
+			static const Decorations none;
+			auto decorations = m_decorations.find(id);
+			return decorations != m_decorations.end() ? decorations->second : none;
+		}
+
+		MemberDecorations GetMemberDecorations(uint32_t structType, uint32_t member) const
+		{
+			auto members = m_memberDecorations.find(structType);
+			if (members == m_memberDecorations.end() || member >= members->second.size())
+				return {};
+			return members->second[member];
+		}
+
+		bool HasBuiltInMembers(uint32_t type) const
+		{
+			auto members = m_memberDecorations.find(type);
+			if (members == m_memberDecorations.end())
+				return false;
+			return std::any_of(members->second.begin(), members->second.end(),
+				[](const MemberDecorations& member) { return member.builtIn; });
+		}
+
+		uint32_t GetArrayLength(const Type& array) const
+		{
+			auto length = m_constants.find(array.operands[1]);
+			if (length == m_constants.end())
+			{
+				throw std::runtime_error("SPIR-V array length is not a constant");
+			}
+			return length->second;
+		}
+
+		// Size in bytes as laid out in a buffer block. matrixStride comes from the enclosing member.
+		uint32_t GetSize(uint32_t id, uint32_t matrixStride) const
+		{
+			const Type& type = GetType(id);
+			switch (type.opcode)
+			{
+			case OpTypeInt:
+			case OpTypeFloat:
+				return type.operands[0] / 8;
+			case OpTypeVector:
+				return type.operands[1] * GetSize(type.operands[0], 0);
+			case OpTypeMatrix:
+				return type.operands[1] * (matrixStride != 0 ? matrixStride : GetSize(type.operands[0], 0));
+			case OpTypeArray:
+			{
+				uint32_t stride = GetDecorations(id).arrayStride;
+				return GetArrayLength(type) * (stride != 0 ? stride : GetSize(type.operands[0], matrixStride));
+			}
+			case OpTypeRuntimeArray:
+				return 0;
+			case OpTypeStruct:
+			{
+				uint32_t size = 0;
+				for (uint32_t member = 0; member < type.operands.size(); member++)
+				{
+					MemberDecorations decorations = GetMemberDecorations(id, member);
+					size = std::max(size, decorations.offset + GetSize(type.operands[member], decorations.matrixStride));
+				}
+				return size;
+			}
+			default:
+				throw std::runtime_error("SPIR-V type %" + std::to_string(id) + " has no buffer layout");
+			}
+		}
+
+		// Formats of one location's worth of a scalar or vector type.
+		VkFormat GetFormat(uint32_t id) const
+		{
+			const Type* type = &GetType(id);
+			uint32_t components = 1;
+			if (type->opcode == OpTypeVector)
+			{
+				components = type->operands[1];
+				type = &GetType(type->operands[0]);
+			}
+			// Each of the 32- and 64-bit UINT/SINT/SFLOAT families steps by 3 per added component.
+			uint32_t width = type->operands[0];
+			VkFormat base = VK_FORMAT_UNDEFINED;
+			if (type->opcode == OpTypeFloat && width == 32)
+				base = VK_FORMAT_R32_SFLOAT;
+			else if (type->opcode == OpTypeFloat && width == 64)
+				base = VK_FORMAT_R64_SFLOAT;
+			else if (type->opcode == OpTypeInt && width == 32)
+				base = type->operands[1] ? VK_FORMAT_R32_SINT : VK_FORMAT_R32_UINT;
+			else if (type->opcode == OpTypeInt && width == 64)
+				base = type->operands[1] ? VK_FORMAT_R64_SINT : VK_FORMAT_R64_UINT;
+			if (base == VK_FORMAT_UNDEFINED || components < 1 || components > 4)
+			{
+				throw std::runtime_error("Unsupported vertex shader input type %" + std::to_string(id));
+			}
+			return static_cast<VkFormat>(base + (components - 1) * 3);
+		}
+
+		void AddInputs(ShaderReflection& reflection, uint32_t location, uint32_t id) const
+		{
+			if (location == NONE)
+			{
+				throw std::runtime_error("Vertex shader input without a location");
+			}
+			const Type& type = GetType(id);
+			if (type.opcode == OpTypeMatrix)
+			{
+				for (uint32_t column = 0; column < type.operands[1]; column++)
+					reflection.inputs.push_back({ location + column, GetFormat(type.operands[0]) });
+			}
+			else
+			{
+				reflection.inputs.push_back({ location, GetFormat(id) });
+			}
+		}
+
+		ReflectedBinding GetBinding(const Variable& variable, const Decorations& decorations, uint32_t id) const
+		{
+			ReflectedBinding binding{};
+			binding.set = decorations.set != NONE ? decorations.set : 0;
+			binding.binding = decorations.binding;
+			binding.count = 1;
+
+			const Type* type = &GetType(id);
+			while (type->opcode == OpTypeArray || type->opcode == OpTypeRuntimeArray)
+			{
+				binding.count = type->opcode == OpTypeArray ? binding.count * GetArrayLength(*type) : 0;
+				id = type->operands[0];
+				type = &GetType(id);
+			}
+
+			switch (type->opcode)
+			{
+			case OpTypeStruct:
+				// Before SPIR-V 1.3 storage buffers were Uniform blocks decorated BufferBlock.
+				binding.type = variable.storageClass == StorageStorageBuffer || GetDecorations(id).bufferBlock ?
+					VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				break;
+			case OpTypeSampler:
+				binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+				break;
+			case OpTypeSampledImage:
+				binding.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				break;
+			case OpTypeImage:
+			{
+				// Operands: sampled type, dim, depth, arrayed, multisampled, sampled (1 sampled, 2 storage).
+				bool storage = type->operands[5] == 2;
+				if (type->operands[1] == DimBuffer)
+					binding.type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				else if (type->operands[1] == DimSubpassData)
+					binding.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				else
+					binding.type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+				break;
+			}
+			case OpTypeAccelerationStructureKHR:
+				binding.type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+				break;
+			default:
+				throw std::runtime_error("Unsupported descriptor type at set " + std::to_string(binding.set) +
+					" binding " + std::to_string(binding.binding));
+			}
+			return binding;
+		}
+
+		bool m_hasEntryPoint = false;
+		VkShaderStageFlagBits m_stage = VK_SHADER_STAGE_VERTEX_BIT;
+		std::unordered_map<uint32_t, Type> m_types;
+		std::unordered_map<uint32_t, uint32_t> m_constants;
+		std::unordered_map<uint32_t, Decorations> m_decorations;
+		std::unordered_map<uint32_t, std::vector<MemberDecorations>> m_memberDecorations;
+		std::vector<Variable> m_variables;
+	};
+}
+
+ShaderReflection ReflectSpirv(const void* code, size_t size)
+{
+	if (size % sizeof(uint32_t) != 0)
+	{
+		throw std::runtime_error("SPIR-V module size is not a multiple of 4");
+	}
+	// Copied so the words are aligned whatever the caller's buffer is.
+	std::vector<uint32_t> words(size / sizeof(uint32_t));
+	memcpy(words.data(), code, size);
+	return Module(words.data(), words.size()).Reflect();
+}
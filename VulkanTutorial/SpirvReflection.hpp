@@ -0,0 +1,37 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ReflectedBinding
+{
+	uint32_t set;
+	uint32_t binding;
+	VkDescriptorType type;
+	// Array size, 0 for runtime-sized arrays.
+	uint32_t count;
+};
+
+// One vertex shader input location; a matrix input takes one per column.
+struct ReflectedInput
+{
+	uint32_t location;
+	VkFormat format;
+};
+
+// What a SPIR-V module needs from its pipeline layout and vertex input state.
+struct ShaderReflection
+{
+	VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+	std::vector<ReflectedBinding> bindings;
+	// Bytes of the push constant block the shader declares, 0 without one.
+	uint32_t pushConstantSize = 0;
+	// Vertex shaders only, sorted by location. Built-ins are left out.
+	std::vector<ReflectedInput> inputs;
+};
+
+// Parses the module's types, decorations and interface variables. Uniform buffers are reported as
+// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; whether one is bound with a dynamic offset is up to the layout.
+// Throws on modules that are not valid SPIR-V or use types with no Vulkan equivalent.
+ShaderReflection ReflectSpirv(const void* code, size_t size);
@@ -0,0 +1,401 @@
+#include "StagingUploader.hpp"
+#include "VulkanTutorial.hpp"
+
+// Keeps every copy source offset suitable for buffer-to-image copies of any texel size as well.
+static const VkDeviceSize UPLOAD_ALIGNMENT = 16;
+
+void StagingUploader::Init(VkDevice device, GpuAllocator& allocator, uint32_t transferFamily, VkQueue transferQueue,
+	uint32_t graphicsFamily, VkQueue graphicsQueue, VkDeviceSize ringSize)
+{
+	m_device = device;
+	m_allocator = &allocator;
+	m_queue = transferQueue;
+	m_transferFamily = transferFamily;
+	m_graphicsFamily = graphicsFamily;
+	m_graphicsQueue = graphicsQueue;
+	m_ownershipTransfer = transferFamily != graphicsFamily;
+	m_ringSize = ringSize;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = transferFamily;
+	VK_CHECKERROR(
+		vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool),
+		"Failed to create upload CommandPool"
+	)
+
+	if (m_ownershipTransfer)
+	{
+		poolInfo.queueFamilyIndex = graphicsFamily;
+		VK_CHECKERROR(
+			vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_graphicsCommandPool),
+			"Failed to create upload acquire CommandPool"
+		)
+	}
+
+	VkSemaphoreTypeCreateInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &timelineInfo;
+	VK_CHECKERROR(
+		vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_timelineSemaphore),
+		"Failed to create upload timeline semaphore"
+	)
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = m_ringSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VK_CHECKERROR(
+		vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_ringBuffer),
+		"Failed to create staging ring buffer"
+	)
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(m_device, m_ringBuffer, &memRequirements);
+	m_ringAllocation = m_allocator->Allocate(memRequirements,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, AllocationKind::Linear);
+	vkBindBufferMemory(m_device, m_ringBuffer, m_ringAllocation.memory, m_ringAllocation.offset);
+
+	spdlog::info("Created staging ring of {} KiB on queue family {}{}", m_ringSize / 1024, transferFamily,
+		m_ownershipTransfer ? " with ownership transfer to graphics" : "");
+}
+
+void StagingUploader::Destroy()
+{
+	vkDestroyBuffer(m_device, m_ringBuffer, nullptr);
+	m_allocator->Free(m_ringAllocation);
+	vkDestroySemaphore(m_device, m_timelineSemaphore, nullptr);
+	vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+	if (m_graphicsCommandPool != VK_NULL_HANDLE)
+		vkDestroyCommandPool(m_device, m_graphicsCommandPool, nullptr);
+	m_inFlight.clear();
+	m_freeCommandBuffers.clear();
+	m_freeGraphicsCommandBuffers.clear();
+	m_graphicsOwned.clear();
+}
+
+void StagingUploader::Upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	const char* source = static_cast<const char*>(data);
+	while (size > 0)
+	{
+		VkDeviceSize chunk = std::min(size, m_ringSize / 2);
+		VkDeviceSize offset;
+		while (!TryAllocate(chunk, offset))
+		{
+			// The ring is full: push out what is queued and wait for the oldest batch to free its space.
+			if (!m_pendingCopies.empty())
+				Flush();
+			if (m_inFlight.empty())
+			{
+				throw std::runtime_error("Staging ring cannot fit upload");
+			}
+			Wait(m_inFlight.front().value);
+		}
+
+		memcpy(static_cast<char*>(m_ringAllocation.mapped) + offset, source, chunk);
+
+		VkBufferCopy region{};
+		region.srcOffset = offset;
+		region.dstOffset = dstOffset;
+		region.size = chunk;
+		m_pendingCopies.push_back({ dst, region });
+
+		source += chunk;
+		dstOffset += chunk;
+		size -= chunk;
+	}
+}
+
+uint64_t StagingUploader::Flush()
+{
+	if (m_pendingCopies.empty())
+		return m_lastSubmittedValue;
+
+	// Copies into buffers the graphics family already owns, which it has to give up first.
+	std::vector<Copy> reuploads;
+	if (m_ownershipTransfer)
+	{
+		for (const Copy& copy : m_pendingCopies)
+		{
+			if (m_graphicsOwned.count(copy.dst))
+				reuploads.push_back(copy);
+		}
+	}
+
+	VkCommandBuffer commandBuffer = AcquireCommandBuffer(m_commandPool, m_freeCommandBuffers);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	if (!reuploads.empty())
+	{
+		auto acquireBarriers = BuildOwnershipBarriers(reuploads, m_graphicsFamily, m_transferFamily, 0,
+			VK_ACCESS_TRANSFER_WRITE_BIT);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, static_cast<uint32_t>(acquireBarriers.size()), acquireBarriers.data(), 0, nullptr);
+	}
+
+	// Consecutive copies into the same buffer go out as one vkCmdCopyBuffer.
+	std::vector<VkBufferCopy> regions;
+	for (size_t i = 0; i < m_pendingCopies.size(); i++)
+	{
+		regions.push_back(m_pendingCopies[i].region);
+		if (i + 1 == m_pendingCopies.size() || m_pendingCopies[i + 1].dst != m_pendingCopies[i].dst)
+		{
+			vkCmdCopyBuffer(commandBuffer, m_ringBuffer, m_pendingCopies[i].dst, static_cast<uint32_t>(regions.size()),
+				regions.data());
+			regions.clear();
+		}
+	}
+
+	if (m_ownershipTransfer)
+	{
+		auto releaseBarriers = BuildOwnershipBarriers(m_pendingCopies, m_transferFamily, m_graphicsFamily,
+			VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, static_cast<uint32_t>(releaseBarriers.size()), releaseBarriers.data(), 0, nullptr);
+	}
+
+	VK_CHECKERROR(
+		vkEndCommandBuffer(commandBuffer),
+		"Failed to record upload command buffer"
+	)
+
+	uint64_t signalValue = m_lastSubmittedValue + 1;
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &m_timelineSemaphore;
+
+	VkCommandBuffer releaseCommandBuffer = VK_NULL_HANDLE;
+	uint64_t releaseValue = 0;
+	VkPipelineStageFlags releaseWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	if (!reuploads.empty())
+	{
+		// Graphics work submitted earlier may still read the old contents; queue order makes the release
+		// wait for it.
+		releaseCommandBuffer = AcquireCommandBuffer(m_graphicsCommandPool, m_freeGraphicsCommandBuffers);
+		vkBeginCommandBuffer(releaseCommandBuffer, &beginInfo);
+		auto releaseBarriers = BuildOwnershipBarriers(reuploads, m_graphicsFamily, m_transferFamily,
+			VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, 0);
+		vkCmdPipelineBarrier(releaseCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<uint32_t>(releaseBarriers.size()),
+			releaseBarriers.data(), 0, nullptr);
+		VK_CHECKERROR(
+			vkEndCommandBuffer(releaseCommandBuffer),
+			"Failed to record upload release command buffer"
+		)
+
+		submitInfo.pCommandBuffers = &releaseCommandBuffer;
+		VK_CHECKERROR(
+			vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE),
+			"Failed to submit upload ownership release"
+		)
+
+		releaseValue = signalValue;
+		signalValue++;
+		timelineInfo.waitSemaphoreValueCount = 1;
+		timelineInfo.pWaitSemaphoreValues = &releaseValue;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &m_timelineSemaphore;
+		submitInfo.pWaitDstStageMask = &releaseWaitStage;
+	}
+
+	submitInfo.pCommandBuffers = &commandBuffer;
+	VK_CHECKERROR(
+		vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE),
+		"Failed to submit uploads"
+	)
+
+	VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+	if (m_ownershipTransfer)
+	{
+		// Hand the buffers back to the graphics family; this submission waits for the copies and
+		// signals the next value, which is the one frames wait on.
+		acquireCommandBuffer = AcquireCommandBuffer(m_graphicsCommandPool, m_freeGraphicsCommandBuffers);
+		vkBeginCommandBuffer(acquireCommandBuffer, &beginInfo);
+		auto acquireBarriers = BuildOwnershipBarriers(m_pendingCopies, m_transferFamily, m_graphicsFamily, 0,
+			VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+		vkCmdPipelineBarrier(acquireCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, static_cast<uint32_t>(acquireBarriers.size()),
+			acquireBarriers.data(), 0, nullptr);
+		VK_CHECKERROR(
+			vkEndCommandBuffer(acquireCommandBuffer),
+			"Failed to record upload acquire command buffer"
+		)
+
+		uint64_t waitValue = signalValue;
+		signalValue++;
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		timelineInfo.waitSemaphoreValueCount = 1;
+		timelineInfo.pWaitSemaphoreValues = &waitValue;
+
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &m_timelineSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.pCommandBuffers = &acquireCommandBuffer;
+
+		VK_CHECKERROR(
+			vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE),
+			"Failed to submit upload ownership acquire"
+		)
+
+		for (const Copy& copy : m_pendingCopies)
+			m_graphicsOwned.insert(copy.dst);
+	}
+
+	m_inFlight.push_back({ m_pendingBegin, m_pendingBytes, signalValue, commandBuffer, releaseCommandBuffer,
+		acquireCommandBuffer });
+	m_pendingBegin = m_head;
+	m_pendingBytes = 0;
+	m_pendingCopies.clear();
+	m_lastSubmittedValue = signalValue;
+	return signalValue;
+}
+
+bool StagingUploader::IsComplete(uint64_t value) const
+{
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(m_device, m_timelineSemaphore, &completed);
+	return completed >= value;
+}
+
+void StagingUploader::Wait(uint64_t value) const
+{
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &m_timelineSemaphore;
+	waitInfo.pValues = &value;
+	vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX);
+}
+
+bool StagingUploader::TryAllocate(VkDeviceSize size, VkDeviceSize& offset)
+{
+	Retire();
+
+	if (m_usedBytes == 0)
+	{
+		m_head = 0;
+		m_pendingBegin = 0;
+	}
+
+	// Oldest byte still owned by a queued or in-flight batch; everything from m_head up to it is free.
+	VkDeviceSize tail = m_inFlight.empty() ? m_pendingBegin : m_inFlight.front().begin;
+	VkDeviceSize aligned = (m_head + UPLOAD_ALIGNMENT - 1) / UPLOAD_ALIGNMENT * UPLOAD_ALIGNMENT;
+	bool wrapped = false;
+
+	if (m_usedBytes == 0 || m_head > tail)
+	{
+		if (aligned + size <= m_ringSize)
+			offset = aligned;
+		else if (size <= tail)
+			wrapped = true;
+		else
+			return false;
+	}
+	else if (aligned + size <= tail)
+	{
+		offset = aligned;
+	}
+	else
+	{
+		return false;
+	}
+
+	// When wrapping, the unused end of the ring is charged to this batch and freed together with it.
+	VkDeviceSize consumed;
+	if (wrapped)
+	{
+		offset = 0;
+		consumed = (m_ringSize - m_head) + size;
+	}
+	else
+	{
+		consumed = (offset + size) - m_head;
+	}
+
+	m_head = offset + size;
+	m_usedBytes += consumed;
+	m_pendingBytes += consumed;
+	return true;
+}
+
+void StagingUploader::Retire()
+{
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(m_device, m_timelineSemaphore, &completed);
+	while (!m_inFlight.empty() && m_inFlight.front().value <= completed)
+	{
+		m_usedBytes -= m_inFlight.front().bytes;
+		m_freeCommandBuffers.push_back(m_inFlight.front().commandBuffer);
+		if (m_inFlight.front().releaseCommandBuffer != VK_NULL_HANDLE)
+			m_freeGraphicsCommandBuffers.push_back(m_inFlight.front().releaseCommandBuffer);
+		if (m_inFlight.front().acquireCommandBuffer != VK_NULL_HANDLE)
+			m_freeGraphicsCommandBuffers.push_back(m_inFlight.front().acquireCommandBuffer);
+		m_inFlight.pop_front();
+	}
+}
+
+std::vector<VkBufferMemoryBarrier> StagingUploader::BuildOwnershipBarriers(const std::vector<Copy>& copies,
+	uint32_t srcFamily, uint32_t dstFamily, VkAccessFlags srcAccess, VkAccessFlags dstAccess) const
+{
+	// Release and acquire must describe identical ranges, so both sides are built from the same copy list.
+	std::vector<VkBufferMemoryBarrier> barriers;
+	barriers.reserve(copies.size());
+	for (const auto& copy : copies)
+	{
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = srcFamily;
+		barrier.dstQueueFamilyIndex = dstFamily;
+		barrier.buffer = copy.dst;
+		barrier.offset = copy.region.dstOffset;
+		barrier.size = copy.region.size;
+		barriers.push_back(barrier);
+	}
+	return barriers;
+}
+
+VkCommandBuffer StagingUploader::AcquireCommandBuffer(VkCommandPool pool, std::vector<VkCommandBuffer>& freeList)
+{
+	Retire();
+	if (!freeList.empty())
+	{
+		VkCommandBuffer commandBuffer = freeList.back();
+		freeList.pop_back();
+		vkResetCommandBuffer(commandBuffer, 0);
+		return commandBuffer;
+	}
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = pool;
+	allocInfo.commandBufferCount = 1;
+	VkCommandBuffer commandBuffer;
+	VK_CHECKERROR(
+		vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer),
+		"Failed to allocate upload command buffer"
+	)
+	return commandBuffer;
+}
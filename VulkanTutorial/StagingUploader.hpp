@@ -0,0 +1,86 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <unordered_set>
+#include "Allocator.hpp"
+
+// Streams data to device-local buffers through one persistently mapped ring buffer.
+// Copies are queued on the CPU and go out together with Flush; completion is tracked with a
+// timeline semaphore, so neither the caller nor the queue ever has to idle for an upload.
+// When the transfer queue belongs to a different family than graphics, every batch releases its
+// buffers on the transfer queue and a small acquire submission on the graphics queue takes them
+// back, so the value returned by Flush always means "usable on the graphics queue". Uploading into a
+// buffer that graphics already received from an earlier batch first releases the copied ranges on the
+// graphics queue and acquires them on the transfer queue.
+class StagingUploader
+{
+public:
+	void Init(VkDevice device, GpuAllocator& allocator, uint32_t transferFamily, VkQueue transferQueue,
+	          uint32_t graphicsFamily, VkQueue graphicsQueue, VkDeviceSize ringSize = 32ull * 1024 * 1024);
+	void Destroy();
+
+	// Copies size bytes from data into the ring and queues a copy into dst, splitting it if it is larger
+	// than the ring. Only blocks when the ring is full of copies the GPU has not finished yet.
+	void Upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+	// Submits every queued copy in a single command buffer and returns the timeline value that
+	// signals their completion.
+	uint64_t Flush();
+
+	bool IsComplete(uint64_t value) const;
+	void Wait(uint64_t value) const;
+
+	VkSemaphore GetTimelineSemaphore() const { return m_timelineSemaphore; }
+	uint64_t GetLastSubmittedValue() const { return m_lastSubmittedValue; }
+
+private:
+	struct Copy
+	{
+		VkBuffer dst;
+		VkBufferCopy region;
+	};
+
+	struct Batch
+	{
+		VkDeviceSize begin;
+		VkDeviceSize bytes;
+		uint64_t value;
+		VkCommandBuffer commandBuffer;
+		VkCommandBuffer releaseCommandBuffer;
+		VkCommandBuffer acquireCommandBuffer;
+	};
+
+	bool TryAllocate(VkDeviceSize size, VkDeviceSize& offset);
+	void Retire();
+	VkCommandBuffer AcquireCommandBuffer(VkCommandPool pool, std::vector<VkCommandBuffer>& freeList);
+	std::vector<VkBufferMemoryBarrier> BuildOwnershipBarriers(const std::vector<Copy>& copies, uint32_t srcFamily,
+		uint32_t dstFamily, VkAccessFlags srcAccess, VkAccessFlags dstAccess) const;
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	GpuAllocator* m_allocator = nullptr;
+	VkQueue m_queue = VK_NULL_HANDLE;
+	VkCommandPool m_commandPool = VK_NULL_HANDLE;
+	uint32_t m_transferFamily = 0;
+	uint32_t m_graphicsFamily = 0;
+	VkQueue m_graphicsQueue = VK_NULL_HANDLE;
+	VkCommandPool m_graphicsCommandPool = VK_NULL_HANDLE;
+	bool m_ownershipTransfer = false;
+	VkSemaphore m_timelineSemaphore = VK_NULL_HANDLE;
+	uint64_t m_lastSubmittedValue = 0;
+
+	VkBuffer m_ringBuffer = VK_NULL_HANDLE;
+	Allocation m_ringAllocation;
+	VkDeviceSize m_ringSize = 0;
+	VkDeviceSize m_head = 0;
+	VkDeviceSize m_usedBytes = 0;
+	VkDeviceSize m_pendingBegin = 0;
+	VkDeviceSize m_pendingBytes = 0;
+
+	std::vector<Copy> m_pendingCopies;
+	std::deque<Batch> m_inFlight;
+	std::vector<VkCommandBuffer> m_freeCommandBuffers;
+	// From the graphics pool, for both the release and the acquire side.
+	std::vector<VkCommandBuffer> m_freeGraphicsCommandBuffers;
+	// Buffers an earlier batch handed to the graphics family.
+	std::unordered_set<VkBuffer> m_graphicsOwned;
+};
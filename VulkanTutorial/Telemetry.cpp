@@ -0,0 +1,87 @@
+#include "Telemetry.hpp"
+#include "VulkanTutorial.hpp"
+
+void MetricSeries::Add(double value)
+{
+	if (m_samples.size() < m_capacity)
+	{
+		m_samples.push_back(value);
+		return;
+	}
+	m_samples[m_next] = value;
+	m_next = (m_next + 1) % m_capacity;
+}
+
+void MetricSeries::Clear()
+{
+	m_samples.clear();
+	m_next = 0;
+}
+
+MetricSummary MetricSeries::Summarize() const
+{
+	MetricSummary summary;
+	if (m_samples.empty())
+		return summary;
+
+	std::vector<double> sorted = m_samples;
+	std::sort(sorted.begin(), sorted.end());
+
+	double total = 0.0;
+	for (double sample : sorted)
+		total += sample;
+
+	summary.count = sorted.size();
+	summary.min = sorted.front();
+	summary.max = sorted.back();
+	summary.avg = total / sorted.size();
+	summary.p99 = sorted[std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * 0.99))];
+	return summary;
+}
+
+std::string SummaryToJson(const MetricSummary& summary)
+{
+	if (summary.count == 0)
+		return "null";
+
+	return fmt::format("{{ \"min\": {:.4f}, \"avg\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f} }}",
+		summary.min, summary.avg, summary.p99, summary.max);
+}
+
+static void LogMetric(const char* name, const MetricSeries& series)
+{
+	if (series.Empty())
+		return;
+
+	MetricSummary summary = series.Summarize();
+	spdlog::info("  {:<18} min {:8.3f} ms  avg {:8.3f} ms  p99 {:8.3f} ms  max {:8.3f} ms", name, summary.min,
+		summary.avg, summary.p99, summary.max);
+}
+
+void FrameTelemetry::Clear()
+{
+	acquireWait.Clear();
+	fenceWait.Clear();
+	record.Clear();
+	cpuSubmit.Clear();
+	submitToGpuComplete.Clear();
+}
+
+void FrameTelemetry::Log() const
+{
+	spdlog::info("Frame telemetry:");
+	LogMetric("acquire wait", acquireWait);
+	LogMetric("fence wait", fenceWait);
+	LogMetric("record", record);
+	LogMetric("cpu submit", cpuSubmit);
+	LogMetric("submit to gpu complete", submitToGpuComplete);
+}
+
+std::string FrameTelemetry::ToJson() const
+{
+	return fmt::format("{{ \"acquire_wait_ms\": {}, \"fence_wait_ms\": {}, \"record_ms\": {}, "
+		"\"cpu_submit_ms\": {}, \"submit_to_gpu_complete_ms\": {} }}",
+		SummaryToJson(acquireWait.Summarize()), SummaryToJson(fenceWait.Summarize()),
+		SummaryToJson(record.Summarize()), SummaryToJson(cpuSubmit.Summarize()),
+		SummaryToJson(submitToGpuComplete.Summarize()));
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct MetricSummary
+{
+	size_t count = 0;
+	double min = 0.0;
+	double avg = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+};
+
+// Keeps the most recent samples of one per-frame measurement, so long interactive sessions
+// neither grow without bound nor average away what happened recently.
+class MetricSeries
+{
+public:
+	explicit MetricSeries(size_t capacity = 65536) : m_capacity(capacity) {}
+
+	void Add(double value);
+	void Clear();
+	bool Empty() const { return m_samples.empty(); }
+	MetricSummary Summarize() const;
+
+private:
+	std::vector<double> m_samples;
+	size_t m_capacity;
+	size_t m_next = 0;
+};
+
+std::string SummaryToJson(const MetricSummary& summary);
+
+// CPU-side timings of every frame, in milliseconds.
+struct FrameTelemetry
+{
+	// Blocked in vkAcquireNextImageKHR waiting for the presentation engine to release an image.
+	MetricSeries acquireWait;
+	// Blocked on the frame-in-flight fence, i.e. the GPU is more than framesInFlight frames behind.
+	MetricSeries fenceWait;
+	// Uniform update and command buffer recording.
+	MetricSeries record;
+	// From the start of recording, after the image was acquired, until vkQueueSubmit returned.
+	MetricSeries cpuSubmit;
+	// From vkQueueSubmit until the frame's fence was seen signaled, i.e. its GPU work finished. This is
+	// not present latency. The fence is only polled at the start of later frames, so the value is an
+	// upper bound rounded up to the next poll.
+	MetricSeries submitToGpuComplete;
+
+	void Clear();
+	void Log() const;
+	std::string ToJson() const;
+};
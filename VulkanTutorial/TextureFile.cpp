@@ -0,0 +1,332 @@
+#include "TextureFile.hpp"
+#include "VulkanTutorial.hpp"
+
+namespace
+{
+	const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+	const uint32_t DDPF_FOURCC = 0x4;
+	const uint32_t DDPF_RGB = 0x40;
+
+	struct DdsPixelFormat
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t rgbBitCount;
+		uint32_t rBitMask;
+		uint32_t gBitMask;
+		uint32_t bBitMask;
+		uint32_t aBitMask;
+	};
+
+	struct DdsHeader
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11];
+		DdsPixelFormat pixelFormat;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+
+	struct DdsHeaderDx10
+	{
+		uint32_t dxgiFormat;
+		uint32_t resourceDimension;
+		uint32_t miscFlag;
+		uint32_t arraySize;
+		uint32_t miscFlags2;
+	};
+
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	struct Ktx2Header
+	{
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+
+	struct Ktx2Level
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	constexpr uint32_t FourCC(char a, char b, char c, char d)
+	{
+		return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) |
+			(static_cast<uint32_t>(d) << 24);
+	}
+
+	VkFormat DxgiToVkFormat(uint32_t dxgiFormat)
+	{
+		switch (dxgiFormat)
+		{
+		case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+		case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+		case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+		case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+		case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+		case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+		case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+		case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+		case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+		case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+		case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+		case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+		case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+		case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+		case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+		case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+		default: return VK_FORMAT_UNDEFINED;
+		}
+	}
+}
+
+bool GetFormatBlockInfo(VkFormat format, FormatBlockInfo& info)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		info = { 1, 1, 4 };
+		return true;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+		info = { 4, 4, 8 };
+		return true;
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		info = { 4, 4, 16 };
+		return true;
+	default:
+		break;
+	}
+
+	// ASTC LDR formats come in UNORM/SRGB pairs from 4x4 to 12x12, every block is 16 bytes.
+	if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+	{
+		static const uint8_t astcBlocks[][2] = {
+			{ 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 }, { 8, 8 },
+			{ 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 }
+		};
+		const uint8_t* block = astcBlocks[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+		info = { block[0], block[1], 16 };
+		return true;
+	}
+	return false;
+}
+
+bool IsBlockCompressed(VkFormat format)
+{
+	FormatBlockInfo info;
+	return GetFormatBlockInfo(format, info) && (info.width > 1 || info.height > 1);
+}
+
+void TextureFile::Open(const std::string& path)
+{
+	Close();
+	m_file.Open(path);
+	try
+	{
+		if (m_file.GetSize() >= sizeof(KTX2_IDENTIFIER) &&
+			memcmp(m_file.GetData(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0)
+			ParseKtx2(path);
+		else
+			ParseDds(path);
+	}
+	catch (...)
+	{
+		Close();
+		throw;
+	}
+}
+
+void TextureFile::Close()
+{
+	m_levels.clear();
+	m_format = VK_FORMAT_UNDEFINED;
+	m_file.Close();
+}
+
+uint64_t TextureFile::GetBlockRowBytes(uint32_t level) const
+{
+	return static_cast<uint64_t>((m_levels[level].width + m_block.width - 1) / m_block.width) * m_block.bytes;
+}
+
+uint32_t TextureFile::GetBlockRows(uint32_t level) const
+{
+	return (m_levels[level].height + m_block.height - 1) / m_block.height;
+}
+
+void TextureFile::ParseDds(const std::string& path)
+{
+	const char* data = static_cast<const char*>(m_file.GetData());
+	size_t size = m_file.GetSize();
+	uint32_t magic = 0;
+	if (size >= sizeof(magic) + sizeof(DdsHeader))
+		memcpy(&magic, data, sizeof(magic));
+	if (magic != DDS_MAGIC)
+	{
+		throw std::runtime_error("Texture " + path + " is neither a DDS nor a KTX2 file");
+	}
+
+	DdsHeader header;
+	memcpy(&header, data + sizeof(magic), sizeof(header));
+	uint64_t offset = sizeof(magic) + sizeof(header);
+	const DdsPixelFormat& pixelFormat = header.pixelFormat;
+	if (pixelFormat.flags & DDPF_FOURCC)
+	{
+		switch (pixelFormat.fourCC)
+		{
+		case FourCC('D', 'X', 'T', '1'): m_format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+		case FourCC('D', 'X', 'T', '2'):
+		case FourCC('D', 'X', 'T', '3'): m_format = VK_FORMAT_BC2_UNORM_BLOCK; break;
+		case FourCC('D', 'X', 'T', '4'):
+		case FourCC('D', 'X', 'T', '5'): m_format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+		case FourCC('A', 'T', 'I', '1'):
+		case FourCC('B', 'C', '4', 'U'): m_format = VK_FORMAT_BC4_UNORM_BLOCK; break;
+		case FourCC('A', 'T', 'I', '2'):
+		case FourCC('B', 'C', '5', 'U'): m_format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+		case FourCC('D', 'X', '1', '0'):
+		{
+			if (size < offset + sizeof(DdsHeaderDx10))
+			{
+				throw std::runtime_error("Texture " + path + " is truncated");
+			}
+			DdsHeaderDx10 dx10;
+			memcpy(&dx10, data + offset, sizeof(dx10));
+			offset += sizeof(dx10);
+			// 3 is D3D10_RESOURCE_DIMENSION_TEXTURE2D.
+			if (dx10.resourceDimension != 3)
+			{
+				throw std::runtime_error("Texture " + path + " is not a 2D texture");
+			}
+			m_format = DxgiToVkFormat(dx10.dxgiFormat);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	else if ((pixelFormat.flags & DDPF_RGB) && pixelFormat.rgbBitCount == 32)
+	{
+		if (pixelFormat.rBitMask == 0x000000ff && pixelFormat.bBitMask == 0x00ff0000)
+			m_format = VK_FORMAT_R8G8B8A8_UNORM;
+		else if (pixelFormat.rBitMask == 0x00ff0000 && pixelFormat.bBitMask == 0x000000ff)
+			m_format = VK_FORMAT_B8G8R8A8_UNORM;
+	}
+
+	if (!GetFormatBlockInfo(m_format, m_block))
+	{
+		throw std::runtime_error("Texture " + path + " has an unsupported DDS pixel format");
+	}
+	AddLevels(path, header.width, header.height, std::max(header.mipMapCount, 1u), offset);
+}
+
+void TextureFile::ParseKtx2(const std::string& path)
+{
+	const char* data = static_cast<const char*>(m_file.GetData());
+	size_t size = m_file.GetSize();
+	if (size < sizeof(Ktx2Header))
+	{
+		throw std::runtime_error("Texture " + path + " is truncated");
+	}
+
+	Ktx2Header header;
+	memcpy(&header, data, sizeof(header));
+	if (header.supercompressionScheme != 0)
+	{
+		throw std::runtime_error("Texture " + path + " uses KTX2 supercompression, which is not supported");
+	}
+	if (header.pixelDepth > 1)
+	{
+		throw std::runtime_error("Texture " + path + " is not a 2D texture");
+	}
+	m_format = static_cast<VkFormat>(header.vkFormat);
+	if (!GetFormatBlockInfo(m_format, m_block))
+	{
+		throw std::runtime_error("Texture " + path + " has unsupported format " + std::to_string(header.vkFormat));
+	}
+
+	// A level count of 0 asks the loader to generate the mip chain.
+	uint32_t levelCount = std::max(header.levelCount, 1u);
+	if (size < sizeof(header) + levelCount * sizeof(Ktx2Level))
+	{
+		throw std::runtime_error("Texture " + path + " is truncated");
+	}
+
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		Ktx2Level index;
+		memcpy(&index, data + sizeof(header) + level * sizeof(Ktx2Level), sizeof(index));
+		uint32_t width = std::max(header.pixelWidth >> level, 1u);
+		uint32_t height = std::max(header.pixelHeight >> level, 1u);
+		uint64_t levelSize = static_cast<uint64_t>((width + m_block.width - 1) / m_block.width) *
+			((height + m_block.height - 1) / m_block.height) * m_block.bytes;
+		// The level holds every layer and face; the first one comes first.
+		if (index.byteLength < levelSize || index.byteOffset + index.byteLength > size)
+		{
+			throw std::runtime_error("Texture " + path + " is corrupt");
+		}
+		m_levels.push_back({ data + index.byteOffset, levelSize, width, height });
+	}
+}
+
+void TextureFile::AddLevels(const std::string& path, uint32_t width, uint32_t height, uint32_t levelCount,
+	uint64_t offset)
+{
+	const char* data = static_cast<const char*>(m_file.GetData());
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		uint32_t levelWidth = std::max(width >> level, 1u);
+		uint32_t levelHeight = std::max(height >> level, 1u);
+		uint64_t levelSize = static_cast<uint64_t>((levelWidth + m_block.width - 1) / m_block.width) *
+			((levelHeight + m_block.height - 1) / m_block.height) * m_block.bytes;
+		if (offset + levelSize > m_file.GetSize())
+		{
+			throw std::runtime_error("Texture " + path + " is truncated");
+		}
+		m_levels.push_back({ data + offset, levelSize, levelWidth, levelHeight });
+		offset += levelSize;
+	}
+}
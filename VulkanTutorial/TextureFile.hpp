@@ -0,0 +1,55 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+
+// Size of the blocks a format is stored in; 1x1 for uncompressed formats.
+struct FormatBlockInfo
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytes;
+};
+
+// Returns false for formats textures cannot be loaded in: block compressed (BC1-7, ASTC LDR) and 8-bit RGBA/BGRA.
+bool GetFormatBlockInfo(VkFormat format, FormatBlockInfo& info);
+bool IsBlockCompressed(VkFormat format);
+
+// A memory-mapped 2D texture in DDS (legacy FourCC or DX10 header) or KTX2 (no supercompression) form.
+// Only the first array layer or cube face is used. Levels point straight into the mapping.
+class TextureFile
+{
+public:
+	struct Level
+	{
+		const void* data;
+		uint64_t size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	void Open(const std::string& path);
+	void Close();
+
+	VkFormat GetFormat() const { return m_format; }
+	const FormatBlockInfo& GetBlockInfo() const { return m_block; }
+	uint32_t GetWidth() const { return m_levels[0].width; }
+	uint32_t GetHeight() const { return m_levels[0].height; }
+	uint32_t GetLevelCount() const { return static_cast<uint32_t>(m_levels.size()); }
+	const Level& GetLevel(uint32_t level) const { return m_levels[level]; }
+
+	// Bytes of one row of blocks and the number of block rows of a level.
+	uint64_t GetBlockRowBytes(uint32_t level) const;
+	uint32_t GetBlockRows(uint32_t level) const;
+
+private:
+	void ParseDds(const std::string& path);
+	void ParseKtx2(const std::string& path);
+	void AddLevels(const std::string& path, uint32_t width, uint32_t height, uint32_t levelCount, uint64_t offset);
+
+	IO::MappedFile m_file;
+	VkFormat m_format = VK_FORMAT_UNDEFINED;
+	FormatBlockInfo m_block{};
+	std::vector<Level> m_levels;
+};
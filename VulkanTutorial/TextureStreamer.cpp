@@ -0,0 +1,584 @@
+#include "TextureStreamer.hpp"
+#include "VulkanTutorial.hpp"
+
+#include <cmath>
+
+// Levels at or below this size form the tail that is loaded first and never evicted on its own.
+static const uint32_t TEXTURE_TAIL_SIZE = 128;
+static const VkPipelineStageFlags TEXTURE_SHADER_STAGES =
+	VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+static void TransitionLevels(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseLevel, uint32_t levelCount,
+	VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+	VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, 1 };
+	vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void TextureStreamer::Init(VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator& allocator,
+	BindlessDescriptors& bindless, DeletionQueue& deletionQueue, uint32_t graphicsFamily, uint32_t framesInFlight,
+	VkDeviceSize budgetBytes, VkDeviceSize stagingBytesPerFrame)
+{
+	m_physicalDevice = physicalDevice;
+	m_device = device;
+	m_allocator = &allocator;
+	m_bindless = &bindless;
+	m_deletionQueue = &deletionQueue;
+	m_budgetBytes = budgetBytes;
+	m_stagingBytesPerFrame = stagingBytesPerFrame;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = graphicsFamily;
+	VK_CHECKERROR(
+		vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool),
+		"Failed to create texture streaming CommandPool"
+	)
+
+	m_commandBuffers.resize(framesInFlight);
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = m_commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = framesInFlight;
+	VK_CHECKERROR(
+		vkAllocateCommandBuffers(m_device, &allocInfo, m_commandBuffers.data()),
+		"Failed to allocate texture streaming command buffers"
+	)
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = m_stagingBytesPerFrame * framesInFlight;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VK_CHECKERROR(
+		vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_stagingBuffer),
+		"Failed to create texture staging buffer"
+	)
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(m_device, m_stagingBuffer, &memRequirements);
+	m_stagingAllocation = m_allocator->Allocate(memRequirements,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, AllocationKind::Linear);
+	vkBindBufferMemory(m_device, m_stagingBuffer, m_stagingAllocation.memory, m_stagingAllocation.offset);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	samplerInfo.maxAnisotropy = 1.0f;
+	VK_CHECKERROR(
+		vkCreateSampler(m_device, &samplerInfo, nullptr, &m_sampler),
+		"Failed to create texture sampler"
+	)
+	m_samplerIndex = m_bindless->RegisterSampler(m_sampler);
+
+	// A 1x1 white image stands in for textures whose tail has not arrived yet.
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	imageInfo.extent = { 1, 1, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VK_CHECKERROR(
+		vkCreateImage(m_device, &imageInfo, nullptr, &m_placeholder.image),
+		"Failed to create placeholder texture"
+	)
+	vkGetImageMemoryRequirements(m_device, m_placeholder.image, &memRequirements);
+	m_placeholder.allocation = m_allocator->Allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		AllocationKind::Optimal);
+	vkBindImageMemory(m_device, m_placeholder.image, m_placeholder.allocation.memory, m_placeholder.allocation.offset);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = m_placeholder.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = imageInfo.format;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	VK_CHECKERROR(
+		vkCreateImageView(m_device, &viewInfo, nullptr, &m_placeholder.view),
+		"Failed to create placeholder texture view"
+	)
+	m_placeholder.imageIndex = m_bindless->RegisterImage(m_placeholder.view);
+
+	spdlog::info("Created texture streamer: {} MiB budget, {} MiB staging per frame", m_budgetBytes >> 20,
+		m_stagingBytesPerFrame >> 20);
+}
+
+void TextureStreamer::Destroy()
+{
+	for (Texture& texture : m_textures)
+	{
+		if (texture.resident.image != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(m_device, texture.resident.view, nullptr);
+			vkDestroyImage(m_device, texture.resident.image, nullptr);
+			m_allocator->Free(texture.resident.allocation);
+		}
+		if (texture.pending.image != VK_NULL_HANDLE)
+		{
+			vkDestroyImage(m_device, texture.pending.image, nullptr);
+			m_allocator->Free(texture.pending.allocation);
+		}
+	}
+	m_textures.clear();
+	vkDestroyImageView(m_device, m_placeholder.view, nullptr);
+	vkDestroyImage(m_device, m_placeholder.image, nullptr);
+	m_allocator->Free(m_placeholder.allocation);
+	vkDestroySampler(m_device, m_sampler, nullptr);
+	vkDestroyBuffer(m_device, m_stagingBuffer, nullptr);
+	m_allocator->Free(m_stagingAllocation);
+	vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+}
+
+uint32_t TextureStreamer::Load(const std::string& path)
+{
+	Texture& texture = m_textures.emplace_back();
+	texture.path = path;
+	try
+	{
+		texture.file.Open(path);
+	}
+	catch (...)
+	{
+		m_textures.pop_back();
+		throw;
+	}
+
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(m_physicalDevice, texture.file.GetFormat(), &formatProperties);
+	VkFormatFeatureFlags features = formatProperties.optimalTilingFeatures;
+	if (!(features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+	{
+		m_textures.pop_back();
+		throw std::runtime_error("Texture " + path + " uses a format the device cannot sample");
+	}
+
+	uint32_t width = texture.file.GetWidth();
+	uint32_t height = texture.file.GetHeight();
+	texture.levelCount = texture.file.GetLevelCount();
+	if (texture.levelCount == 1 && std::max(width, height) > 1)
+	{
+		// Block-compressed formats cannot be blit destinations; those are drawn without mips.
+		VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		if (!IsBlockCompressed(texture.file.GetFormat()) && (features & blitFeatures) == blitFeatures)
+		{
+			texture.generateMips = true;
+			texture.levelCount = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+		}
+		else
+		{
+			spdlog::warn("Texture {} has no mips and they cannot be generated for its format", path);
+		}
+	}
+
+	texture.tailMip = 0;
+	if (!texture.generateMips)
+	{
+		while (texture.tailMip + 1 < texture.levelCount &&
+			std::max(texture.file.GetLevel(texture.tailMip).width, texture.file.GetLevel(texture.tailMip).height) >
+			TEXTURE_TAIL_SIZE)
+			texture.tailMip++;
+	}
+	texture.resident.firstMip = texture.levelCount;
+	texture.resident.imageIndex = m_placeholder.imageIndex;
+	return static_cast<uint32_t>(m_textures.size() - 1);
+}
+
+void TextureStreamer::Request(uint32_t textureIndex, uint32_t mip)
+{
+	Texture& texture = m_textures[textureIndex];
+	texture.requestedMip = texture.lastUsedFrame == m_frameNumber ? std::min(texture.requestedMip, mip) : mip;
+	texture.lastUsedFrame = m_frameNumber;
+}
+
+uint32_t TextureStreamer::GetImageIndex(uint32_t texture) const
+{
+	return m_textures[texture].resident.imageIndex;
+}
+
+VkCommandBuffer TextureStreamer::RecordFrame(uint32_t frame)
+{
+	m_frame = frame;
+	m_recording = VK_NULL_HANDLE;
+	m_stagingUsed = 0;
+
+	if (!m_placeholderReady)
+	{
+		VkCommandBuffer commandBuffer = BeginCommands();
+		const uint32_t white = 0xffffffff;
+		VkDeviceSize offset = static_cast<VkDeviceSize>(m_frame) * m_stagingBytesPerFrame;
+		memcpy(static_cast<char*>(m_stagingAllocation.mapped) + offset, &white, sizeof(white));
+		m_stagingUsed = 16;
+		TransitionLevels(commandBuffer, m_placeholder.image, 0, 1, VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT);
+		VkBufferImageCopy region{};
+		region.bufferOffset = offset;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		region.imageExtent = { 1, 1, 1 };
+		vkCmdCopyBufferToImage(commandBuffer, m_stagingBuffer, m_placeholder.image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		TransitionLevels(commandBuffer, m_placeholder.image, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, TEXTURE_SHADER_STAGES);
+		m_placeholderReady = true;
+	}
+
+	// Unfinished uploads first, then the most recently requested textures that want more detail.
+	std::vector<Texture*> candidates;
+	for (Texture& texture : m_textures)
+	{
+		bool wantsMore = texture.lastUsedFrame == m_frameNumber && texture.requestedMip < texture.resident.firstMip;
+		if (texture.pending.image != VK_NULL_HANDLE || wantsMore)
+			candidates.push_back(&texture);
+	}
+	std::stable_sort(candidates.begin(), candidates.end(), [](const Texture* a, const Texture* b)
+	{
+		bool aPending = a->pending.image != VK_NULL_HANDLE, bPending = b->pending.image != VK_NULL_HANDLE;
+		if (aPending != bPending)
+			return aPending;
+		return a->lastUsedFrame > b->lastUsedFrame;
+	});
+
+	for (Texture* texture : candidates)
+	{
+		if (texture->pending.image == VK_NULL_HANDLE)
+		{
+			uint32_t firstMip = texture->generateMips ? 0 :
+				texture->resident.image == VK_NULL_HANDLE ? texture->tailMip : texture->resident.firstMip - 1;
+			// Both images exist until the new one is published, so the whole new image must fit.
+			if (!MakeRoom(EstimateBytes(*texture, firstMip)))
+				break;
+			texture->pending = CreateImage(*texture, firstMip);
+			StartGrowing(*texture);
+		}
+		if (!Upload(*texture))
+			break;
+	}
+
+	m_frameNumber++;
+	if (m_recording == VK_NULL_HANDLE)
+		return VK_NULL_HANDLE;
+	VK_CHECKERROR(
+		vkEndCommandBuffer(m_recording),
+		"Failed to record texture streaming command buffer"
+	)
+	return m_recording;
+}
+
+TextureStreamer::Statistics TextureStreamer::GetStatistics() const
+{
+	Statistics statistics;
+	statistics.textures = static_cast<uint32_t>(m_textures.size());
+	for (const Texture& texture : m_textures)
+	{
+		if (texture.resident.image != VK_NULL_HANDLE)
+			statistics.residentTextures++;
+		if (texture.resident.image != VK_NULL_HANDLE && texture.resident.firstMip == 0)
+			statistics.fullyResidentTextures++;
+		if (texture.generateMips)
+			statistics.generatedMipChains++;
+	}
+	statistics.residentBytes = m_residentBytes;
+	statistics.budgetBytes = m_budgetBytes;
+	statistics.uploadedBytes = m_uploadedBytes;
+	statistics.evictions = m_evictions;
+	return statistics;
+}
+
+VkCommandBuffer TextureStreamer::BeginCommands()
+{
+	if (m_recording != VK_NULL_HANDLE)
+		return m_recording;
+
+	m_recording = m_commandBuffers[m_frame];
+	vkResetCommandBuffer(m_recording, 0);
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_CHECKERROR(
+		vkBeginCommandBuffer(m_recording, &beginInfo),
+		"Failed to begin texture streaming command buffer"
+	)
+	return m_recording;
+}
+
+TextureStreamer::ImageVersion TextureStreamer::CreateImage(const Texture& texture, uint32_t firstMip)
+{
+	ImageVersion version;
+	version.firstMip = firstMip;
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = texture.file.GetFormat();
+	imageInfo.extent = { std::max(texture.file.GetWidth() >> firstMip, 1u),
+		std::max(texture.file.GetHeight() >> firstMip, 1u), 1 };
+	imageInfo.mipLevels = texture.levelCount - firstMip;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VK_CHECKERROR(
+		vkCreateImage(m_device, &imageInfo, nullptr, &version.image),
+		"Failed to create texture image"
+	)
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(m_device, version.image, &memRequirements);
+	version.allocation = m_allocator->Allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		AllocationKind::Optimal);
+	vkBindImageMemory(m_device, version.image, version.allocation.memory, version.allocation.offset);
+	version.bytes = memRequirements.size;
+	m_residentBytes += version.bytes;
+
+	TransitionLevels(BeginCommands(), version.image, 0, imageInfo.mipLevels, VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT);
+	return version;
+}
+
+void TextureStreamer::Publish(Texture& texture, ImageVersion& version)
+{
+	uint32_t levelCount = texture.levelCount - version.firstMip;
+	TransitionLevels(BeginCommands(), version.image, 0, levelCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, TEXTURE_SHADER_STAGES);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = version.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = texture.file.GetFormat();
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+	VK_CHECKERROR(
+		vkCreateImageView(m_device, &viewInfo, nullptr, &version.view),
+		"Failed to create texture image view"
+	)
+	// A fresh slot: the old one may still be read by frames in flight.
+	version.imageIndex = m_bindless->RegisterImage(version.view);
+
+	if (texture.resident.image != VK_NULL_HANDLE)
+	{
+		m_residentBytes -= texture.resident.bytes;
+		Retire(texture.resident);
+	}
+	texture.resident = version;
+	version = ImageVersion{};
+}
+
+void TextureStreamer::Retire(const ImageVersion& version)
+{
+	// Frames in flight may still sample it through its slot, so the slot is only reused after them too.
+	m_deletionQueue->PushImageView(version.view);
+	m_deletionQueue->PushImage(version.image, version.allocation);
+	uint32_t imageIndex = version.imageIndex;
+	m_deletionQueue->Push([this, imageIndex]() { m_bindless->Release(BindlessDescriptors::SampledImages, imageIndex); });
+}
+
+void TextureStreamer::CopyLevels(const Texture& texture, const ImageVersion& source, const ImageVersion& destination)
+{
+	// Texture levels both images hold, from the more detailed of their first levels on.
+	uint32_t firstMip = std::max(source.firstMip, destination.firstMip);
+	uint32_t levelCount = texture.levelCount - firstMip;
+	uint32_t sourceBase = firstMip - source.firstMip;
+	VkCommandBuffer commandBuffer = BeginCommands();
+
+	TransitionLevels(commandBuffer, source.image, sourceBase, levelCount, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 0, VK_ACCESS_TRANSFER_READ_BIT, TEXTURE_SHADER_STAGES,
+		VK_PIPELINE_STAGE_TRANSFER_BIT);
+	std::vector<VkImageCopy> regions(levelCount);
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		VkImageCopy& region = regions[i];
+		region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, sourceBase + i, 0, 1 };
+		region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, firstMip - destination.firstMip + i, 0, 1 };
+		region.extent = { std::max(texture.file.GetWidth() >> (firstMip + i), 1u),
+			std::max(texture.file.GetHeight() >> (firstMip + i), 1u), 1 };
+	}
+	vkCmdCopyImage(commandBuffer, source.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destination.image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, regions.data());
+	// Frames recorded after this one still sample the source until the new image is published.
+	TransitionLevels(commandBuffer, source.image, sourceBase, levelCount, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		TEXTURE_SHADER_STAGES);
+}
+
+void TextureStreamer::StartGrowing(Texture& texture)
+{
+	if (texture.resident.image != VK_NULL_HANDLE && !texture.generateMips)
+		CopyLevels(texture, texture.resident, texture.pending);
+	texture.uploadLevel = texture.pending.firstMip;
+	texture.uploadedRows = 0;
+}
+
+uint32_t TextureStreamer::UploadEnd(const Texture& texture) const
+{
+	if (texture.generateMips)
+		return 1;
+	return texture.resident.image != VK_NULL_HANDLE ? texture.resident.firstMip : texture.levelCount;
+}
+
+bool TextureStreamer::Upload(Texture& texture)
+{
+	const TextureFile& file = texture.file;
+	const FormatBlockInfo& block = file.GetBlockInfo();
+	VkCommandBuffer commandBuffer = BeginCommands();
+	char* staging = static_cast<char*>(m_stagingAllocation.mapped) + static_cast<VkDeviceSize>(m_frame) * m_stagingBytesPerFrame;
+
+	uint32_t uploadEnd = UploadEnd(texture);
+	while (texture.uploadLevel < uploadEnd)
+	{
+		// Whole rows of blocks, as many as the frame's staging space has room for.
+		const TextureFile::Level& level = file.GetLevel(texture.uploadLevel);
+		uint64_t rowBytes = file.GetBlockRowBytes(texture.uploadLevel);
+		uint32_t totalRows = file.GetBlockRows(texture.uploadLevel);
+		VkDeviceSize offset = (m_stagingUsed + 15) / 16 * 16;
+		uint64_t available = offset < m_stagingBytesPerFrame ? m_stagingBytesPerFrame - offset : 0;
+		uint32_t rows = static_cast<uint32_t>(std::min<uint64_t>(totalRows - texture.uploadedRows, available / rowBytes));
+		if (rows == 0)
+		{
+			if (rowBytes > m_stagingBytesPerFrame)
+			{
+				throw std::runtime_error("Texture " + texture.path + " has rows larger than the staging space");
+			}
+			return false;
+		}
+
+		uint64_t sourceOffset = static_cast<uint64_t>(texture.uploadedRows) * rowBytes;
+		memcpy(staging + offset, static_cast<const char*>(level.data) + sourceOffset, rows * rowBytes);
+		m_stagingUsed = offset + rows * rowBytes;
+		m_uploadedBytes += rows * rowBytes;
+
+		uint32_t y = texture.uploadedRows * block.height;
+		VkBufferImageCopy region{};
+		region.bufferOffset = static_cast<VkDeviceSize>(m_frame) * m_stagingBytesPerFrame + offset;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, texture.uploadLevel - texture.pending.firstMip, 0, 1 };
+		region.imageOffset = { 0, static_cast<int32_t>(y), 0 };
+		region.imageExtent = { level.width, std::min(rows * block.height, level.height - y), 1 };
+		vkCmdCopyBufferToImage(commandBuffer, m_stagingBuffer, texture.pending.image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		texture.uploadedRows += rows;
+		if (texture.uploadedRows == totalRows)
+		{
+			texture.uploadLevel++;
+			texture.uploadedRows = 0;
+		}
+	}
+
+	if (texture.generateMips)
+		GenerateMips(texture, texture.pending);
+	Publish(texture, texture.pending);
+	return true;
+}
+
+void TextureStreamer::GenerateMips(const Texture& texture, const ImageVersion& version)
+{
+	VkCommandBuffer commandBuffer = BeginCommands();
+	int32_t width = static_cast<int32_t>(texture.file.GetWidth());
+	int32_t height = static_cast<int32_t>(texture.file.GetHeight());
+	for (uint32_t level = 1; level < texture.levelCount; level++)
+	{
+		TransitionLevels(commandBuffer, version.image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		int32_t nextWidth = std::max(width / 2, 1);
+		int32_t nextHeight = std::max(height / 2, 1);
+		VkImageBlit blit{};
+		blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+		blit.srcOffsets[1] = { width, height, 1 };
+		blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+		blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+		vkCmdBlitImage(commandBuffer, version.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, version.image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		// Publish expects every level in TRANSFER_DST.
+		TransitionLevels(commandBuffer, version.image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		width = nextWidth;
+		height = nextHeight;
+	}
+}
+
+bool TextureStreamer::MakeRoom(VkDeviceSize bytes)
+{
+	while (m_residentBytes + bytes > m_budgetBytes)
+	{
+		// Least recently requested texture not used this frame that has more than its tail.
+		Texture* victim = nullptr;
+		for (Texture& texture : m_textures)
+		{
+			bool evictable = texture.lastUsedFrame != m_frameNumber && texture.pending.image == VK_NULL_HANDLE &&
+				texture.resident.image != VK_NULL_HANDLE && (texture.generateMips || texture.resident.firstMip < texture.tailMip);
+			if (evictable && (victim == nullptr || texture.lastUsedFrame < victim->lastUsedFrame))
+				victim = &texture;
+		}
+		if (victim == nullptr)
+			return false;
+		Evict(*victim);
+	}
+	return true;
+}
+
+void TextureStreamer::Evict(Texture& texture)
+{
+	m_evictions++;
+	if (texture.generateMips)
+	{
+		// Nothing smaller than the full chain can be rebuilt from the file, so the whole texture goes.
+		m_residentBytes -= texture.resident.bytes;
+		Retire(texture.resident);
+		texture.resident = ImageVersion{};
+		texture.resident.firstMip = texture.levelCount;
+		texture.resident.imageIndex = m_placeholder.imageIndex;
+		return;
+	}
+
+	ImageVersion tail = CreateImage(texture, texture.tailMip);
+	CopyLevels(texture, texture.resident, tail);
+	Publish(texture, tail);
+}
+
+VkDeviceSize TextureStreamer::EstimateBytes(const Texture& texture, uint32_t firstMip) const
+{
+	FormatBlockInfo block = texture.file.GetBlockInfo();
+	VkDeviceSize bytes = 0;
+	for (uint32_t mip = firstMip; mip < texture.levelCount; mip++)
+	{
+		uint32_t width = std::max(texture.file.GetWidth() >> mip, 1u);
+		uint32_t height = std::max(texture.file.GetHeight() >> mip, 1u);
+		bytes += static_cast<VkDeviceSize>((width + block.width - 1) / block.width) *
+			((height + block.height - 1) / block.height) * block.bytes;
+	}
+	return bytes;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "Allocator.hpp"
+#include "BindlessDescriptors.hpp"
+#include "DeletionQueue.hpp"
+#include "TextureFile.hpp"
+
+// Streams DDS/KTX2 textures into a fixed VRAM budget. Every texture gets its small mip tail first and
+// then one more detailed level at a time while it keeps being requested, within a per-frame staging
+// budget, so a large set comes in over several frames instead of all up front. When the budget is
+// full, the least recently requested textures drop back to their tail. Textures stored without mips
+// get a full chain blitted on the GPU, and are streamed all or nothing since level 0 is their only source.
+//
+// Images cannot change their level count, so every residency change builds a new image, copies the
+// levels both have and swaps the bindless slot; the old image goes to the deletion queue. All work is
+// recorded on the graphics queue, where blits are allowed.
+class TextureStreamer
+{
+public:
+	struct Statistics
+	{
+		uint32_t textures = 0;
+		uint32_t residentTextures = 0;
+		uint32_t fullyResidentTextures = 0;
+		VkDeviceSize residentBytes = 0;
+		VkDeviceSize budgetBytes = 0;
+		uint64_t uploadedBytes = 0;
+		uint32_t evictions = 0;
+		uint32_t generatedMipChains = 0;
+	};
+
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator& allocator, BindlessDescriptors& bindless,
+	          DeletionQueue& deletionQueue, uint32_t graphicsFamily, uint32_t framesInFlight, VkDeviceSize budgetBytes,
+	          VkDeviceSize stagingBytesPerFrame = 16ull * 1024 * 1024);
+	void Destroy();
+
+	// Maps the file and returns the texture's handle. Nothing is uploaded until it is requested.
+	uint32_t Load(const std::string& path);
+	// Marks the texture as used this frame, wanting levels down to mip (0 is full resolution).
+	void Request(uint32_t texture, uint32_t mip = 0);
+	// Bindless image slot of the texture's current levels, a white placeholder until its tail is in.
+	// Changes whenever RecordFrame changes the texture's residency.
+	uint32_t GetImageIndex(uint32_t texture) const;
+	uint32_t GetSamplerIndex() const { return m_samplerIndex; }
+
+	// Records this frame's evictions, uploads and mip generation. Must be called after the frame's fence
+	// has signaled, since it reuses the frame's command buffer and staging region, and the result
+	// submitted before the frame's own command buffer. Returns VK_NULL_HANDLE when there was nothing to do.
+	VkCommandBuffer RecordFrame(uint32_t frame);
+
+	Statistics GetStatistics() const;
+
+private:
+	struct ImageVersion
+	{
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		Allocation allocation;
+		VkDeviceSize bytes = 0;
+		uint32_t imageIndex = UINT32_MAX;
+		// Texture level held in the image's level 0.
+		uint32_t firstMip = 0;
+	};
+
+	struct Texture
+	{
+		std::string path;
+		TextureFile file;
+		uint32_t levelCount = 0;
+		bool generateMips = false;
+		// Levels from tailMip on are loaded together and only dropped with the whole texture.
+		uint32_t tailMip = 0;
+		// firstMip == levelCount while nothing is resident.
+		ImageVersion resident;
+		// Image being built with one more level, or VK_NULL_HANDLE; uploadLevel and uploadedRows track
+		// the level being uploaded across frames.
+		ImageVersion pending;
+		uint32_t uploadLevel = 0;
+		uint32_t uploadedRows = 0;
+		uint32_t requestedMip = UINT32_MAX;
+		uint64_t lastUsedFrame = 0;
+	};
+
+	VkCommandBuffer BeginCommands();
+	ImageVersion CreateImage(const Texture& texture, uint32_t firstMip);
+	void Publish(Texture& texture, ImageVersion& version);
+	void Retire(const ImageVersion& version);
+	void CopyLevels(const Texture& texture, const ImageVersion& source, const ImageVersion& destination);
+	void StartGrowing(Texture& texture);
+	bool Upload(Texture& texture);
+	void GenerateMips(const Texture& texture, const ImageVersion& version);
+	bool MakeRoom(VkDeviceSize bytes);
+	void Evict(Texture& texture);
+	VkDeviceSize EstimateBytes(const Texture& texture, uint32_t firstMip) const;
+	uint32_t UploadEnd(const Texture& texture) const;
+
+	VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+	VkDevice m_device = VK_NULL_HANDLE;
+	GpuAllocator* m_allocator = nullptr;
+	BindlessDescriptors* m_bindless = nullptr;
+	DeletionQueue* m_deletionQueue = nullptr;
+	VkDeviceSize m_budgetBytes = 0;
+	VkDeviceSize m_residentBytes = 0;
+	uint64_t m_uploadedBytes = 0;
+	uint32_t m_evictions = 0;
+	uint64_t m_frameNumber = 1;
+
+	VkCommandPool m_commandPool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> m_commandBuffers;
+	VkCommandBuffer m_recording = VK_NULL_HANDLE;
+	uint32_t m_frame = 0;
+
+	// One persistently mapped staging region per frame in flight.
+	VkBuffer m_stagingBuffer = VK_NULL_HANDLE;
+	Allocation m_stagingAllocation;
+	VkDeviceSize m_stagingBytesPerFrame = 0;
+	VkDeviceSize m_stagingUsed = 0;
+
+	VkSampler m_sampler = VK_NULL_HANDLE;
+	uint32_t m_samplerIndex = 0;
+	ImageVersion m_placeholder;
+	bool m_placeholderReady = false;
+
+	// Deque, so textures keep their address (TextureFile holds a mapping and cannot move).
+	std::deque<Texture> m_textures;
+};
@@ -0,0 +1,67 @@
+#include "ThreadCommandPools.hpp"
+#include "VulkanTutorial.hpp"
+
+void ThreadCommandPools::Init(VkDevice device, uint32_t queueFamily, uint32_t framesInFlight, uint32_t threadCount)
+{
+	m_device = device;
+	m_threadCount = threadCount;
+	m_pools.resize(framesInFlight * threadCount);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+	for (Pool& pool : m_pools)
+	{
+		VK_CHECKERROR(
+			vkCreateCommandPool(m_device, &poolInfo, nullptr, &pool.pool),
+			"Failed to create thread CommandPool"
+		)
+	}
+
+	spdlog::info("Created {} command pools for {} threads", m_pools.size(), threadCount);
+}
+
+void ThreadCommandPools::Destroy()
+{
+	for (Pool& pool : m_pools)
+		vkDestroyCommandPool(m_device, pool.pool, nullptr);
+	m_pools.clear();
+}
+
+void ThreadCommandPools::BeginFrame(uint32_t frame)
+{
+	for (uint32_t thread = 0; thread < m_threadCount; thread++)
+	{
+		Pool& pool = GetPool(frame, thread);
+		if (pool.used[0] == 0 && pool.used[1] == 0)
+			continue;
+
+		vkResetCommandPool(m_device, pool.pool, 0);
+		pool.used[0] = 0;
+		pool.used[1] = 0;
+	}
+}
+
+VkCommandBuffer ThreadCommandPools::Acquire(uint32_t frame, uint32_t thread, VkCommandBufferLevel level)
+{
+	Pool& pool = GetPool(frame, thread);
+	std::vector<VkCommandBuffer>& buffers = pool.buffers[level];
+	size_t& used = pool.used[level];
+	if (used == buffers.size())
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = pool.pool;
+		allocInfo.level = level;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		VK_CHECKERROR(
+			vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer),
+			"Failed to allocate thread CommandBuffer"
+		)
+		buffers.push_back(commandBuffer);
+	}
+	return buffers[used++];
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+
+// One command pool per (frame in flight, recording thread). A pool is only ever touched by its own
+// thread, so recording needs no locks, and a frame's pools are reset wholesale once its fence has
+// signaled instead of resetting buffers one by one.
+class ThreadCommandPools
+{
+public:
+	void Init(VkDevice device, uint32_t queueFamily, uint32_t framesInFlight, uint32_t threadCount);
+	void Destroy();
+
+	// Resets every pool of the frame; all its command buffers can be handed out again.
+	void BeginFrame(uint32_t frame);
+	// Returns a command buffer from the thread's pool for the frame, allocating one if none is free.
+	VkCommandBuffer Acquire(uint32_t frame, uint32_t thread, VkCommandBufferLevel level);
+
+	uint32_t GetThreadCount() const { return m_threadCount; }
+
+private:
+	struct Pool
+	{
+		VkCommandPool pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> buffers[2];
+		size_t used[2] = {};
+	};
+
+	Pool& GetPool(uint32_t frame, uint32_t thread) { return m_pools[frame * m_threadCount + thread]; }
+
+	VkDevice m_device = VK_NULL_HANDLE;
+	uint32_t m_threadCount = 0;
+	std::vector<Pool> m_pools;
+};
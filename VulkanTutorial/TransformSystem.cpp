@@ -0,0 +1,178 @@
+#include "TransformSystem.hpp"
+#include "VulkanTutorial.hpp"
+
+#if defined(__AVX__)
+#define TRANSFORM_KERNEL_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_KERNEL_SSE
+#include <xmmintrin.h>
+#endif
+
+static const uint32_t TRANSFORM_BATCH_WIDTH = 8;
+
+void TransformSystem::SetCamera(const glm::vec3& eye, const glm::vec3& target, const glm::vec3& up)
+{
+	if (eye == m_eye && target == m_target && up == m_up)
+		return;
+	m_eye = eye;
+	m_target = target;
+	m_up = up;
+	m_cameraDirty = true;
+}
+
+void TransformSystem::SetProjection(float fovY, float aspect, float nearZ, float farZ)
+{
+	if (fovY == m_fovY && aspect == m_aspect && nearZ == m_nearZ && farZ == m_farZ)
+		return;
+	m_fovY = fovY;
+	m_aspect = aspect;
+	m_nearZ = nearZ;
+	m_farZ = farZ;
+	m_cameraDirty = true;
+}
+
+bool TransformSystem::UpdateViewProjection()
+{
+	if (!m_cameraDirty)
+		return false;
+	m_viewProjection = glm::perspective(m_fovY, m_aspect, m_nearZ, m_farZ) * glm::lookAt(m_eye, m_target, m_up);
+	m_cameraDirty = false;
+	return true;
+}
+
+void TransformSystem::Resize(uint32_t count)
+{
+	if (count > m_stride)
+	{
+		uint32_t stride = (count + TRANSFORM_BATCH_WIDTH - 1) / TRANSFORM_BATCH_WIDTH * TRANSFORM_BATCH_WIDTH;
+		std::vector<float> elements(static_cast<size_t>(stride) * 16, 0.0f);
+		for (uint32_t element = 0; element < 16; element++)
+			std::copy_n(Stream(element), m_count, elements.data() + static_cast<size_t>(element) * stride);
+		m_elements = std::move(elements);
+		m_stride = stride;
+	}
+
+	for (uint32_t i = m_count; i < count; i++)
+		SetModel(i, glm::mat4(1.0f));
+	m_count = count;
+}
+
+void TransformSystem::SetModel(uint32_t index, const glm::mat4& model)
+{
+	for (uint32_t column = 0; column < 4; column++)
+	{
+		for (uint32_t row = 0; row < 4; row++)
+			Stream(column * 4 + row)[index] = model[column][row];
+	}
+}
+
+glm::mat4 TransformSystem::GetModel(uint32_t index) const
+{
+	glm::mat4 model;
+	for (uint32_t column = 0; column < 4; column++)
+	{
+		for (uint32_t row = 0; row < 4; row++)
+			model[column][row] = Stream(column * 4 + row)[index];
+	}
+	return model;
+}
+
+// Element (column c, row r) of the product is sum over k of viewProjection(row r, column k) * model(column c,
+// row k). Each register holds one element of 4 or 8 consecutive objects, so a column of results is
+// transposed back into one column per object before it is stored.
+void TransformSystem::ComputeModelViewProjection(uint32_t first, uint32_t count, glm::mat4* out) const
+{
+	const glm::mat4& vp = m_viewProjection;
+	const float* streams[16];
+	for (uint32_t element = 0; element < 16; element++)
+		streams[element] = Stream(element) + first;
+
+	uint32_t i = 0;
+#if defined(TRANSFORM_KERNEL_AVX)
+	__m256 v[16];
+	for (uint32_t k = 0; k < 4; k++)
+	{
+		for (uint32_t row = 0; row < 4; row++)
+			v[k * 4 + row] = _mm256_set1_ps(vp[k][row]);
+	}
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 m[16];
+		for (uint32_t element = 0; element < 16; element++)
+			m[element] = _mm256_loadu_ps(streams[element] + i);
+
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			__m256 result[4];
+			for (uint32_t row = 0; row < 4; row++)
+			{
+				__m256 sum = _mm256_mul_ps(v[row], m[column * 4]);
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(v[4 + row], m[column * 4 + 1]));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(v[8 + row], m[column * 4 + 2]));
+				result[row] = _mm256_add_ps(sum, _mm256_mul_ps(v[12 + row], m[column * 4 + 3]));
+			}
+
+			__m128 low[4], high[4];
+			for (uint32_t row = 0; row < 4; row++)
+			{
+				low[row] = _mm256_castps256_ps128(result[row]);
+				high[row] = _mm256_extractf128_ps(result[row], 1);
+			}
+			_MM_TRANSPOSE4_PS(low[0], low[1], low[2], low[3]);
+			_MM_TRANSPOSE4_PS(high[0], high[1], high[2], high[3]);
+			for (uint32_t object = 0; object < 4; object++)
+			{
+				_mm_storeu_ps(&out[i + object][column][0], low[object]);
+				_mm_storeu_ps(&out[i + 4 + object][column][0], high[object]);
+			}
+		}
+	}
+#elif defined(TRANSFORM_KERNEL_SSE)
+	__m128 v[16];
+	for (uint32_t k = 0; k < 4; k++)
+	{
+		for (uint32_t row = 0; row < 4; row++)
+			v[k * 4 + row] = _mm_set1_ps(vp[k][row]);
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 m[16];
+		for (uint32_t element = 0; element < 16; element++)
+			m[element] = _mm_loadu_ps(streams[element] + i);
+
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			__m128 result[4];
+			for (uint32_t row = 0; row < 4; row++)
+			{
+				__m128 sum = _mm_mul_ps(v[row], m[column * 4]);
+				sum = _mm_add_ps(sum, _mm_mul_ps(v[4 + row], m[column * 4 + 1]));
+				sum = _mm_add_ps(sum, _mm_mul_ps(v[8 + row], m[column * 4 + 2]));
+				result[row] = _mm_add_ps(sum, _mm_mul_ps(v[12 + row], m[column * 4 + 3]));
+			}
+
+			_MM_TRANSPOSE4_PS(result[0], result[1], result[2], result[3]);
+			for (uint32_t object = 0; object < 4; object++)
+				_mm_storeu_ps(&out[i + object][column][0], result[object]);
+		}
+	}
+#endif
+
+	// Scalar fallback, and the tail the batch kernels leave.
+	for (; i < count; i++)
+		out[i] = vp * GetModel(first + i);
+}
+
+const char* TransformSystem::GetKernelName()
+{
+#if defined(TRANSFORM_KERNEL_AVX)
+	return "avx";
+#elif defined(TRANSFORM_KERNEL_SSE)
+	return "sse";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+// Camera and object transforms. View-projection is cached and only rebuilt when the camera or the
+// aspect ratio changes. Object model matrices are stored as 16 element streams (SoA) so the batch
+// kernels can premultiply 4 (SSE) or 8 (AVX) objects per iteration into the column-major matrices the
+// GPU reads.
+class TransformSystem
+{
+public:
+	void SetCamera(const glm::vec3& eye, const glm::vec3& target, const glm::vec3& up);
+	void SetProjection(float fovY, float aspect, float nearZ, float farZ);
+	// Rebuilds view-projection if anything changed since the last call and returns whether it did.
+	bool UpdateViewProjection();
+	const glm::mat4& GetViewProjection() const { return m_viewProjection; }
+
+	void Resize(uint32_t count);
+	uint32_t GetCount() const { return m_count; }
+	void SetModel(uint32_t index, const glm::mat4& model);
+	glm::mat4 GetModel(uint32_t index) const;
+
+	// Writes view-projection * model for objects [first, first + count) to out[0, count).
+	void ComputeModelViewProjection(uint32_t first, uint32_t count, glm::mat4* out) const;
+	static const char* GetKernelName();
+
+private:
+	float* Stream(uint32_t element) { return m_elements.data() + static_cast<size_t>(element) * m_stride; }
+	const float* Stream(uint32_t element) const { return m_elements.data() + static_cast<size_t>(element) * m_stride; }
+
+	glm::vec3 m_eye = glm::vec3(0.0f);
+	glm::vec3 m_target = glm::vec3(0.0f);
+	glm::vec3 m_up = glm::vec3(0.0f);
+	float m_fovY = 0.0f;
+	float m_aspect = 0.0f;
+	float m_nearZ = 0.0f;
+	float m_farZ = 0.0f;
+	bool m_cameraDirty = true;
+	glm::mat4 m_viewProjection = glm::mat4(1.0f);
+
+	uint32_t m_count = 0;
+	// Floats between the starts of two element streams, a multiple of the widest kernel.
+	uint32_t m_stride = 0;
+	std::vector<float> m_elements;
+};
@@ -0,0 +1,59 @@
+#include "UniformRing.hpp"
+#include "VulkanTutorial.hpp"
+
+void UniformRing::Init(VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator& allocator,
+	uint32_t framesInFlight, VkDeviceSize bytesPerFrame)
+{
+	m_device = device;
+	m_allocator = &allocator;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	m_alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16);
+	m_bytesPerFrame = (bytesPerFrame + m_alignment - 1) / m_alignment * m_alignment;
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = m_bytesPerFrame * framesInFlight;
+	bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VK_CHECKERROR(
+		vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_buffer),
+		"Failed to create uniform ring buffer"
+	)
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(m_device, m_buffer, &memRequirements);
+	m_allocation = m_allocator->Allocate(memRequirements,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, AllocationKind::Linear);
+	vkBindBufferMemory(m_device, m_buffer, m_allocation.memory, m_allocation.offset);
+
+	spdlog::info("Created uniform ring of {} x {} KiB, {} byte alignment", framesInFlight, m_bytesPerFrame / 1024,
+		m_alignment);
+}
+
+void UniformRing::Destroy()
+{
+	vkDestroyBuffer(m_device, m_buffer, nullptr);
+	m_allocator->Free(m_allocation);
+}
+
+void UniformRing::BeginFrame(uint32_t frame)
+{
+	m_head = frame * m_bytesPerFrame;
+	m_end = m_head + m_bytesPerFrame;
+}
+
+uint32_t UniformRing::Push(const void* data, VkDeviceSize size)
+{
+	if (m_head + size > m_end)
+	{
+		throw std::runtime_error("Uniform ring frame region of " + std::to_string(m_bytesPerFrame) +
+			" bytes exhausted");
+	}
+
+	VkDeviceSize offset = m_head;
+	memcpy(static_cast<char*>(m_allocation.mapped) + offset, data, size);
+	m_head += GetStride(size);
+	return static_cast<uint32_t>(offset);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include "Allocator.hpp"
+
+// One persistently mapped uniform buffer split into a fixed region per frame in flight. Constants are
+// bump-allocated from the current frame's region at minUniformBufferOffsetAlignment and bound through a
+// single UNIFORM_BUFFER_DYNAMIC descriptor with the returned offset. A region is only reused once the
+// frame that last wrote it has finished, and the first allocation of a frame always lands on the
+// region's base, so its offset is the same every time the frame comes around.
+class UniformRing
+{
+public:
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator& allocator, uint32_t framesInFlight,
+	          VkDeviceSize bytesPerFrame = 256 * 1024);
+	void Destroy();
+
+	void BeginFrame(uint32_t frame);
+	// Copies size bytes into the current frame's region and returns the dynamic offset to bind them at.
+	uint32_t Push(const void* data, VkDeviceSize size);
+	template <class T>
+	uint32_t Push(const T& data) { return Push(&data, sizeof(T)); }
+
+	VkBuffer GetBuffer() const { return m_buffer; }
+	// Distance between consecutive pushes of size bytes.
+	uint32_t GetStride(VkDeviceSize size) const
+	{
+		return static_cast<uint32_t>((size + m_alignment - 1) / m_alignment * m_alignment);
+	}
+	uint32_t GetFrameBase(uint32_t frame) const { return static_cast<uint32_t>(frame * m_bytesPerFrame); }
+
+private:
+	VkDevice m_device = VK_NULL_HANDLE;
+	GpuAllocator* m_allocator = nullptr;
+	VkBuffer m_buffer = VK_NULL_HANDLE;
+	Allocation m_allocation;
+	VkDeviceSize m_alignment = 256;
+	VkDeviceSize m_bytesPerFrame = 0;
+	VkDeviceSize m_head = 0;
+	VkDeviceSize m_end = 0;
+};
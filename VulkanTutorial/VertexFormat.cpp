@@ -0,0 +1,104 @@
+#include "VertexFormat.hpp"
+#include "VulkanTutorial.hpp"
+
+#if defined(__F16C__) || defined(__AVX2__)
+#define VERTEX_PACK_F16C
+#include <immintrin.h>
+#endif
+
+// Round-to-nearest-even float to half conversion, including subnormals, infinities and NaN.
+static uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t exponent = (bits >> 23) & 0xff;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	if (exponent == 0xff)
+		return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+
+	int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+	if (halfExponent >= 0x1f)
+		return static_cast<uint16_t>(sign | 0x7c00);
+
+	if (halfExponent <= 0)
+	{
+		if (halfExponent < -10)
+			return static_cast<uint16_t>(sign);
+		mantissa |= 0x800000;
+		uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1)))
+			half++;
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	// A carry out of the mantissa bumps the exponent, which is still the correctly rounded result.
+	uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1fff;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		half++;
+	return static_cast<uint16_t>(sign | half);
+}
+
+static uint8_t FloatToUnorm8(float value)
+{
+	return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+void PackVertices(const Vertex* vertices, size_t count, const glm::vec3& center, float scale, PackedVertex* out)
+{
+#if defined(VERTEX_PACK_F16C)
+	__m128 offset = _mm_set_ps(0.0f, center.z, center.y, center.x);
+	__m128 factor = _mm_set_ps(0.0f, scale, scale, scale);
+	__m128 one = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+#endif
+	for (size_t i = 0; i < count; i++)
+	{
+		const Vertex& vertex = vertices[i];
+		PackedVertex& packed = out[i];
+#if defined(VERTEX_PACK_F16C)
+		__m128 position = _mm_set_ps(0.0f, vertex.pos.z, vertex.pos.y, vertex.pos.x);
+		position = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(position, offset), factor), one);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(packed.position.data()),
+			_mm_cvtps_ph(position, _MM_FROUND_TO_NEAREST_INT));
+#else
+		glm::vec3 position = (vertex.pos - center) * scale;
+		packed.position = { FloatToHalf(position.x), FloatToHalf(position.y), FloatToHalf(position.z),
+			FloatToHalf(1.0f) };
+#endif
+		packed.color = { FloatToUnorm8(vertex.color.r), FloatToUnorm8(vertex.color.g), FloatToUnorm8(vertex.color.b),
+			255 };
+	}
+}
+
+VertexFormat::Octahedral16::Storage EncodeOctahedral(const glm::vec3& normal)
+{
+	glm::vec3 n = normal / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+	glm::vec2 folded(n.x, n.y);
+	if (n.z < 0.0f)
+	{
+		// The lower hemisphere is mirrored into the corners of the square.
+		folded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) *
+			glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	folded = glm::clamp(folded, -1.0f, 1.0f);
+	return { static_cast<int16_t>(std::round(folded.x * 32767.0f)), static_cast<int16_t>(std::round(folded.y * 32767.0f)) };
+}
+
+glm::vec3 DecodeOctahedral(const VertexFormat::Octahedral16::Storage& encoded)
+{
+	glm::vec2 folded = glm::max(glm::vec2(encoded[0], encoded[1]) / 32767.0f, -1.0f);
+	glm::vec3 n(folded.x, folded.y, 1.0f - std::abs(folded.x) - std::abs(folded.y));
+	if (n.z < 0.0f)
+	{
+		glm::vec2 unfolded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) *
+			glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+		n.x = unfolded.x;
+		n.y = unfolded.y;
+	}
+	return glm::normalize(n);
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct Vertex;
+
+// Vertex layouts described as a list of field encodings. Binding and attribute descriptions, offsets and
+// the stride all follow from the list at compile time, so a packed layout cannot drift from its struct.
+namespace VertexFormat
+{
+	struct Float3
+	{
+		using Storage = glm::vec3;
+		static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT;
+	};
+
+	// xyz in half floats, w padding (three-component 16-bit formats are rarely supported for vertex input).
+	struct Half4
+	{
+		using Storage = std::array<uint16_t, 4>;
+		static constexpr VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	};
+
+	struct Unorm8x4
+	{
+		using Storage = std::array<uint8_t, 4>;
+		static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+	};
+
+	// Unit vector folded onto an octahedron, two signed 16-bit coordinates. See EncodeOctahedral.
+	struct Octahedral16
+	{
+		using Storage = std::array<int16_t, 2>;
+		static constexpr VkFormat format = VK_FORMAT_R16G16_SNORM;
+	};
+
+	template <class... Fields>
+	struct Layout
+	{
+		static constexpr uint32_t fieldCount = sizeof...(Fields);
+		static constexpr std::array<uint32_t, fieldCount> sizes = { sizeof(typename Fields::Storage)... };
+		static constexpr std::array<VkFormat, fieldCount> formats = { Fields::format... };
+		static constexpr uint32_t stride = (sizeof(typename Fields::Storage) + ...);
+
+		static constexpr VkVertexInputBindingDescription GetBindingDescription(uint32_t binding = 0)
+		{
+			return { binding, stride, VK_VERTEX_INPUT_RATE_VERTEX };
+		}
+
+		// Fields take consecutive locations from firstLocation, tightly packed in declaration order.
+		static constexpr std::array<VkVertexInputAttributeDescription, fieldCount> GetAttributeDescriptions(
+			uint32_t binding = 0, uint32_t firstLocation = 0)
+		{
+			std::array<VkVertexInputAttributeDescription, fieldCount> attributes{};
+			uint32_t offset = 0;
+			for (uint32_t i = 0; i < fieldCount; i++)
+			{
+				attributes[i] = { firstLocation + i, binding, formats[i], offset };
+				offset += sizes[i];
+			}
+			return attributes;
+		}
+	};
+}
+
+// The layout of Vertex, as stored in .vmesh files.
+using FullVertexFormat = VertexFormat::Layout<VertexFormat::Float3, VertexFormat::Float3>;
+// Half-float position and UNORM8 color: 12 bytes instead of 24.
+using PackedVertexFormat = VertexFormat::Layout<VertexFormat::Half4, VertexFormat::Unorm8x4>;
+
+struct PackedVertex
+{
+	VertexFormat::Half4::Storage position;
+	VertexFormat::Unorm8x4::Storage color;
+};
+static_assert(sizeof(PackedVertex) == PackedVertexFormat::stride);
+
+// Packs count vertices, storing positions as (position - center) * scale so they use the precise
+// range of half floats. Uses F16C conversions when the build enables them.
+void PackVertices(const Vertex* vertices, size_t count, const glm::vec3& center, float scale, PackedVertex* out);
+VertexFormat::Octahedral16::Storage EncodeOctahedral(const glm::vec3& normal);
+glm::vec3 DecodeOctahedral(const VertexFormat::Octahedral16::Storage& encoded);
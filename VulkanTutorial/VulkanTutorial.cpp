@@ -8,8 +8,22 @@
 
 void VulkanTutorialApplication::Run()
 {
-	InitWindow();
+	if (!m_options.convertObjPath.empty())
+	{
+		ConvertObjToMesh(m_options.convertObjPath, m_options.meshPath);
+		return;
+	}
+
+	if (!m_options.headless)
+		InitWindow();
+
+	auto initStart = std::chrono::high_resolution_clock::now();
 	InitVulkan();
+	m_initMilliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - initStart).count();
+	spdlog::info("Vulkan initialized in {:.2f} ms, {:.2f} ms of it creating pipelines with a {} pipeline cache",
+		m_initMilliseconds, m_pipelineMilliseconds, m_pipelineCache.WasLoaded() ? "warm" : "cold");
+
 	MainLoop();
 	Cleanup();
 }
@@ -59,15 +73,38 @@ bool VulkanTutorialApplication::CheckValidationLayerSupport()
 			return false;
 		}
 	}
+	return true;
+}
+
+static bool HasExtension(const std::vector<VkExtensionProperties>& available, const char* name)
+{
+	return std::any_of(available.begin(), available.end(),
+		[&](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, name) == 0; });
 }
 
 std::vector<const char*> VulkanTutorialApplication::GetRequiredExtensions()
 {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> extensions;
 
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	if (!m_options.headless)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+
+		uint32_t availableCount = 0;
+		vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, nullptr);
+		std::vector<VkExtensionProperties> available(availableCount);
+		vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, available.data());
+		m_supportsSurfaceMaintenance = HasExtension(available, VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME) &&
+			HasExtension(available, VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+		if (m_supportsSurfaceMaintenance)
+		{
+			extensions.push_back(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME);
+			extensions.push_back(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+		}
+	}
 
 	if (m_enableValidationLayers)
 	{
@@ -106,6 +143,7 @@ void VulkanTutorialApplication::SetupDebugMessenger()
 
 void VulkanTutorialApplication::InitVulkan()
 {
+	m_framesInFlight = m_options.framesInFlight;
 #ifndef _DEBUG
 	m_enableValidationLayers = false;
 #endif
@@ -114,27 +152,77 @@ void VulkanTutorialApplication::InitVulkan()
 		throw std::runtime_error("Validation layers requested, but not available!");
 	}
 
+	if (m_options.headless)
+	{
+		// No surface means no swapchain, so the device must not ask for VK_KHR_swapchain either.
+		m_deviceExtensions.clear();
+	}
+
 	CreateInstance();
 	SetupDebugMessenger();
-	CreateSurface();
+	if (!m_options.headless)
+		CreateSurface();
 	PickPhysicalDevice();
 	CreateLogicalDevice();
-	CreateSwapChain();
+	if (m_options.headless)
+	{
+		CreateOffscreenTargets();
+	}
+	else
+	{
+		CreateSwapChain();
+	}
 	CreateImageViews();
 	CreateRenderPass();
+	m_bindless.Init(m_physicalDevice, m_device);
 	CreateDescriptorSetLayout();
+	m_jobs.Init(m_options.workerThreads);
+	m_pipelineCache.Init(m_physicalDevice, m_device, m_options.pipelineCachePath);
+	if (m_options.parallelRecording)
+		m_threadCommandPools.Init(m_device, FindQueueFamilies().graphicsFamily, m_framesInFlight,
+			m_jobs.GetWorkerCount() + 1);
 	CreateGraphicsPipeline();
+	if (m_options.hotReload)
+	{
+		// Mirrors res/compile.bat.
+		m_shaderReload.Watch("res/vertex.spv", "res/vertex.glsl", VK_SHADER_STAGE_VERTEX_BIT);
+		m_shaderReload.Watch("res/vertex_object.spv", "res/vertex_object.glsl", VK_SHADER_STAGE_VERTEX_BIT);
+		m_shaderReload.Watch("res/vertex_push.spv", "res/vertex_push.glsl", VK_SHADER_STAGE_VERTEX_BIT);
+		m_shaderReload.Watch("res/fragment.spv", "res/fragment.glsl", VK_SHADER_STAGE_FRAGMENT_BIT);
+		m_shaderReload.Init();
+	}
 	CreateFrameBuffers();
 	CreateCommandPool();
+	if (!m_options.texturePaths.empty())
+	{
+		m_textures.Init(m_physicalDevice, m_device, m_allocator, m_bindless, m_deletionQueue,
+			FindQueueFamilies().graphicsFamily, m_framesInFlight,
+			static_cast<VkDeviceSize>(m_options.textureBudgetMiB) << 20);
+		for (const std::string& path : m_options.texturePaths)
+			m_textureHandles.push_back(m_textures.Load(path));
+	}
+	if (!m_options.meshPath.empty())
+		m_meshFile.Open(m_options.meshPath);
+	if ((m_options.optimizeMesh || m_options.lodCount > 1) && m_meshFile.IsOpen())
+		PrepareLoadedMesh();
 	CreateVertexBuffer();
 	CreateIndexBuffer();
+	CreateMaterials();
+	m_uploader.Flush();
+	// Upload copies into the staging ring right away, so the mapping is no longer needed.
+	m_meshFile.Close();
+	m_meshVertices = {};
+	m_meshIndices = {};
 	CreateUniformBuffers();
+	CreateInstances();
 	CreateDescriptorPool();
 	CreateDescriptorSets();
 	CreateCommandBuffer();
 	CreateSyncObjects();
-
-
+	m_gpuProfiler.Init(m_physicalDevice, m_device, FindQueueFamilies().graphicsFamily, m_framesInFlight);
+	if (m_options.gpuCulling)
+		CreateGpuCulling();
+	m_allocator.LogStatistics();
 }
 
 
@@ -158,8 +246,12 @@ void VulkanTutorialApplication::CreateInstance()
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 	createInfo.ppEnabledExtensionNames = extensions.data();
 
-	createInfo.enabledLayerCount = static_cast<uint32_t>(m_validationLayers.size());
-	createInfo.ppEnabledLayerNames = m_validationLayers.data();
+	createInfo.enabledLayerCount = 0;
+	if (m_enableValidationLayers)
+	{
+		createInfo.enabledLayerCount = static_cast<uint32_t>(m_validationLayers.size());
+		createInfo.ppEnabledLayerNames = m_validationLayers.data();
+	}
 	VK_CHECKERROR(vkCreateInstance(&createInfo, nullptr, &m_instance), "Failed to create instance")
 
 		spdlog::info("Vulkan Instance created with layers: [{}] and extensions: [{}]",
@@ -187,7 +279,25 @@ void VulkanTutorialApplication::PickPhysicalDevice()
 		vkGetPhysicalDeviceProperties(devices[i], &deviceProperties);
 		vkGetPhysicalDeviceFeatures(devices[i], &deviceFeatures);
 
-		if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && deviceFeatures.geometryShader)
+		// The bindless set needs descriptor indexing with update-after-bind, and there is no fallback.
+		VkPhysicalDeviceVulkan12Features supported12Features{};
+		supported12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		VkPhysicalDeviceFeatures2 supportedFeatures{};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures.pNext = &supported12Features;
+		if (deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+			vkGetPhysicalDeviceFeatures2(devices[i], &supportedFeatures);
+		VkPhysicalDeviceVulkan12Features enabled12Features{};
+		if (!BindlessDescriptors::CheckSupport(supported12Features, enabled12Features))
+		{
+			spdlog::warn("Skipping {}: descriptor indexing with update-after-bind is not supported",
+				deviceProperties.deviceName);
+			continue;
+		}
+
+		// Headless runs are meant for CI boxes where the only device may be a CPU implementation such as lavapipe.
+		if (m_options.headless || (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
+			deviceFeatures.geometryShader))
 		{
 			m_physicalDevice = devices[i];
 			break;
@@ -196,7 +306,8 @@ void VulkanTutorialApplication::PickPhysicalDevice()
 
 	if (m_physicalDevice == VK_NULL_HANDLE)
 	{
-		throw std::runtime_error("No acceptable GPU found.");
+		throw std::runtime_error("No acceptable GPU found. Vulkan 1.2 descriptor indexing with update-after-bind "
+			"is required.");
 	}
 	spdlog::info("Found gpu.");
 }
@@ -207,7 +318,7 @@ void VulkanTutorialApplication::CreateLogicalDevice()
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	std::set<uint32_t> uniqueQueueFamilies =
-	{ indices.graphicsFamily, indices.presentFamily };
+	{ indices.graphicsFamily, indices.presentFamily, indices.transferFamily };
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies)
 	{
@@ -220,12 +331,63 @@ void VulkanTutorialApplication::CreateLogicalDevice()
 	}
 
 
+	VkPhysicalDeviceVulkan12Features supported12Features{};
+	supported12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT supportedMaintenance1Features{};
+	supportedMaintenance1Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+	if (m_supportsSurfaceMaintenance)
+	{
+		uint32_t availableCount = 0;
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &availableCount, nullptr);
+		std::vector<VkExtensionProperties> available(availableCount);
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &availableCount, available.data());
+		if (HasExtension(available, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME))
+			supported12Features.pNext = &supportedMaintenance1Features;
+	}
+	VkPhysicalDeviceFeatures2 supportedFeatures{};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures.pNext = &supported12Features;
+	vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures);
+
 	VkPhysicalDeviceFeatures deviceFeatures{};
 
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12Features.timelineSemaphore = VK_TRUE;
+
+	// GPU-driven drawing emits one indirect command per instance, addressed through firstInstance.
+	m_supportsIndirectCount = supported12Features.drawIndirectCount && supportedFeatures.features.multiDrawIndirect &&
+		supportedFeatures.features.drawIndirectFirstInstance;
+	if (m_supportsIndirectCount)
+	{
+		vulkan12Features.drawIndirectCount = VK_TRUE;
+		deviceFeatures.multiDrawIndirect = VK_TRUE;
+		deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	}
+
+	// Present fences tell when a replaced swapchain is no longer used by the presentation engine.
+	VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT maintenance1Features{};
+	maintenance1Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+	m_supportsPresentFences = supportedMaintenance1Features.swapchainMaintenance1;
+	if (m_supportsPresentFences)
+	{
+		maintenance1Features.swapchainMaintenance1 = VK_TRUE;
+		vulkan12Features.pNext = &maintenance1Features;
+		m_deviceExtensions.push_back(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+	}
+	if (!m_options.headless)
+		spdlog::info("Replaced swapchains are released by {}",
+			m_supportsPresentFences ? "present fences" : "acquiring back a presented image");
+
+	// The global descriptor set indexes everything through large update-after-bind arrays.
+	if (!BindlessDescriptors::CheckSupport(supported12Features, vulkan12Features))
+		throw std::runtime_error("Descriptor indexing with update-after-bind is not supported");
+
 
 	VkDeviceCreateInfo createInfo{};
 
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &vulkan12Features;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -253,6 +415,12 @@ void VulkanTutorialApplication::CreateLogicalDevice()
 
 	vkGetDeviceQueue(m_device, indices.graphicsFamily, 0, &m_graphicsQueue);
 	vkGetDeviceQueue(m_device, indices.presentFamily, 0, &m_presentQueue);
+	vkGetDeviceQueue(m_device, indices.transferFamily, 0, &m_transferQueue);
+
+	m_allocator.Init(m_physicalDevice, m_device);
+	m_deletionQueue.Init(m_device, m_allocator);
+	m_uploader.Init(m_device, m_allocator, indices.transferFamily, m_transferQueue, indices.graphicsFamily,
+		m_graphicsQueue);
 
 	spdlog::info("Created logical device. {}", physicalDeviceProperties.deviceName);
 }
@@ -276,8 +444,13 @@ VkSurfaceFormatKHR VulkanTutorialApplication::ChooseSwapChainSurfaceFormat(
 VkPresentModeKHR VulkanTutorialApplication::ChooseSwapChainPresentMode(
 	const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
-	// return VK_PRESENT_MODE_FIFO_KHR;
-	return VK_PRESENT_MODE_MAILBOX_KHR;
+	if (std::find(availablePresentModes.begin(), availablePresentModes.end(), m_options.presentMode) !=
+		availablePresentModes.end())
+	{
+		return m_options.presentMode;
+	}
+	spdlog::info("Present mode {} not supported, falling back to FIFO", static_cast<int>(m_options.presentMode));
+	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
 VkExtent2D VulkanTutorialApplication::ChooseSwapChainExtent(const VkSurfaceCapabilitiesKHR& capabilities)
@@ -317,6 +490,12 @@ QueueFamilyIndices VulkanTutorialApplication::FindQueueFamilies()
 		{
 			indices.graphicsFamily = i;
 
+			if (m_options.headless)
+			{
+				indices.presentFamily = i;
+				break;
+			}
+
 			VkBool32 presentSupport = VK_FALSE;
 			vkGetPhysicalDeviceSurfaceSupportKHR(m_physicalDevice, i, m_surface, &presentSupport);
 			if (presentSupport)
@@ -327,6 +506,23 @@ QueueFamilyIndices VulkanTutorialApplication::FindQueueFamilies()
 		}
 	}
 
+	// Prefer a family that can only copy (the DMA engines on discrete GPUs), then any non-graphics family
+	// with transfer support, so uploads do not compete with rendering on the graphics queue.
+	indices.transferFamily = indices.graphicsFamily;
+	int bestTransferScore = 0;
+	for (int i = 0; i < queueFamilies.size(); i++)
+	{
+		VkQueueFlags flags = queueFamilies[i].queueFlags;
+		if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT))
+			continue;
+
+		int score = (flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+		if (score > bestTransferScore)
+		{
+			bestTransferScore = score;
+			indices.transferFamily = i;
+		}
+	}
 
 	return indices;
 }
@@ -377,7 +573,8 @@ void VulkanTutorialApplication::CreateSwapChain()
 	VkPresentModeKHR presentMode = ChooseSwapChainPresentMode(swapChainSupport.presentModes);
 	VkExtent2D extent = ChooseSwapChainExtent(swapChainSupport.capabilities);
 
-	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+	// Enough images that every frame in flight can hold one while the presentation engine holds another.
+	uint32_t imageCount = std::max(swapChainSupport.capabilities.minImageCount + 1, m_framesInFlight + 1);
 	if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
 	{
 		imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -412,6 +609,8 @@ void VulkanTutorialApplication::CreateSwapChain()
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
+	// Lets the presentation engine reuse the resources of the swapchain being replaced, if any.
+	createInfo.oldSwapchain = m_swapChain;
 
 
 	VK_CHECKERROR(vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &m_swapChain),
@@ -424,10 +623,51 @@ void VulkanTutorialApplication::CreateSwapChain()
 
 	m_swapChainImageFormat = surfaceFormat.format;
 	m_swapChainExtent = extent;
+	m_swapChainImagesPresented.assign(imageCount, false);
 
 	spdlog::info("Created SwapChain");
 }
 
+void VulkanTutorialApplication::CreateOffscreenTargets()
+{
+	// One target per frame in flight, so a frame never renders into an image the GPU may still be writing.
+	m_swapChainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+	m_swapChainExtent = { WIDTH, HEIGHT };
+	m_swapChainImages.resize(m_framesInFlight);
+	m_offscreenImagesAllocations.resize(m_framesInFlight);
+
+	for (size_t i = 0; i < m_framesInFlight; i++)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = m_swapChainImageFormat;
+		imageInfo.extent = { m_swapChainExtent.width, m_swapChainExtent.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VK_CHECKERROR(
+			vkCreateImage(m_device, &imageInfo, nullptr, &m_swapChainImages[i]),
+			"Failed to create offscreen image"
+		)
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(m_device, m_swapChainImages[i], &memRequirements);
+
+		Allocation& allocation = m_offscreenImagesAllocations[i];
+		allocation = m_allocator.Allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, AllocationKind::Optimal);
+		vkBindImageMemory(m_device, m_swapChainImages[i], allocation.memory, allocation.offset);
+	}
+
+	spdlog::info("Created {} offscreen targets {}x{}", m_swapChainImages.size(), m_swapChainExtent.width,
+		m_swapChainExtent.height);
+}
+
 void VulkanTutorialApplication::CreateImageViews()
 {
 	m_swapChainImageViews.resize(m_swapChainImages.size());
@@ -465,7 +705,9 @@ void VulkanTutorialApplication::CreateRenderPass()
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachment.finalLayout = m_options.headless
+		? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+		: VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 
 	VkAttachmentReference colorAttachmentRef{};
@@ -503,152 +745,19 @@ void VulkanTutorialApplication::CreateRenderPass()
 
 void VulkanTutorialApplication::CreateGraphicsPipeline()
 {
-	auto vertexCode = IO::ReadFile("res/vertex.spv");
-	auto fragmentCode = IO::ReadFile("res/fragment.spv");
-
-	VkShaderModule vertexShaderModule = CreateShaderModule(vertexCode);
-	VkShaderModule fragmentShaderModule = CreateShaderModule(fragmentCode);
-
-
-	VkPipelineShaderStageCreateInfo vertexShaderStageCreateInfo{};
-	vertexShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertexShaderStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertexShaderStageCreateInfo.module = vertexShaderModule;
-	vertexShaderStageCreateInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo fragmentShaderStageCreateInfo{};
-	fragmentShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragmentShaderStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragmentShaderStageCreateInfo.module = fragmentShaderModule;
-	fragmentShaderStageCreateInfo.pName = "main";
-
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderStageCreateInfo, fragmentShaderStageCreateInfo };
-
-
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-	};
-
-	VkPipelineDynamicStateCreateInfo dynamicState{};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicState.pDynamicStates = dynamicStates.data();
-
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	auto bindingDescription = Vertex::GetBindingDescription();
-	auto attributeDescriptions = Vertex::GetAttributeDescriptions();
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-
-	VkViewport viewport{};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(m_swapChainExtent.width);
-	viewport.height = static_cast<float>(m_swapChainExtent.height);
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor{};
-	scissor.offset = { 0, 0 };
-	scissor.extent = m_swapChainExtent;
-
-
-	VkPipelineViewportStateCreateInfo viewportState{};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
-
-
-	VkPipelineRasterizationStateCreateInfo rasterizer{};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-	rasterizer.depthBiasConstantFactor = 0.0f;
-	rasterizer.depthBiasClamp = 0.0f;
-	rasterizer.depthBiasSlopeFactor = 0.0f;
-
-	VkPipelineMultisampleStateCreateInfo multisampling{};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
-		| VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo colorBlending{};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.logicOp = VK_LOGIC_OP_COPY;
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-	colorBlending.blendConstants[0] = 0.0f;
-	colorBlending.blendConstants[1] = 0.0f;
-	colorBlending.blendConstants[2] = 0.0f;
-	colorBlending.blendConstants[3] = 0.0f;
-
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1;
-	pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
-
-
-	VK_CHECKERROR(
-		vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout),
-		"Failed to create pipeline layout"
-	)
-
-		VkGraphicsPipelineCreateInfo pipelineInfo {};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = nullptr; // Optional
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = m_pipelineLayout;
-	pipelineInfo.renderPass = m_renderPass;
-	pipelineInfo.subpass = 0;
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-	pipelineInfo.basePipelineIndex = -1; // Optional
-
-
-	VK_CHECKERROR(
-		vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline),
-		"Failed to create Graphics Pipe Line"
-	)
-
-		vkDestroyShaderModule(m_device, fragmentShaderModule, nullptr);
-	vkDestroyShaderModule(m_device, vertexShaderModule, nullptr);
-
-	spdlog::info("We got here.");
+	m_pipelineLibrary.Init(m_device, m_pipelineCache.Get(), m_jobs, m_layoutCache, m_deletionQueue);
+
+	m_mainPipeline = PipelineDesc{};
+	m_mainPipeline.renderPass = m_renderPass;
+	m_mainPipeline.layout = m_pipelineLayout;
+	m_mainPipeline.vertexEncoding = m_options.packedVertices ? VertexEncoding::Packed : VertexEncoding::Full;
+	SetTransformPath(m_options.transformPath);
+
+	// The first frame cannot draw anything without it, so this one is worth waiting for.
+	auto pipelineStart = std::chrono::high_resolution_clock::now();
+	m_pipelineLibrary.RequestBlocking(m_mainPipeline);
+	m_pipelineMilliseconds += std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - pipelineStart).count();
 }
 
 void VulkanTutorialApplication::CreateFrameBuffers()
@@ -695,7 +804,7 @@ void VulkanTutorialApplication::CreateCommandPool()
 
 void VulkanTutorialApplication::CreateCommandBuffer()
 {
-	m_commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	m_commandBuffers.resize(m_framesInFlight);
 	VkCommandBufferAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.commandPool = m_commandPool;
@@ -708,6 +817,12 @@ void VulkanTutorialApplication::CreateCommandBuffer()
 	)
 
 		spdlog::info("Created CommandBuffer");
+
+	CreateCachedCommandBuffers();
+	if (m_options.recordMode == RecordMode::PoolReset)
+		m_framePools.Init(m_device, FindQueueFamilies().graphicsFamily, m_framesInFlight, 1);
+	if (m_options.recordMode == RecordMode::Cached && m_options.parallelRecording)
+		spdlog::warn("Cached command buffers are recorded inline, --parallel-recording is ignored");
 }
 
 void VulkanTutorialApplication::CleanupSwapChain()
@@ -718,41 +833,87 @@ void VulkanTutorialApplication::CleanupSwapChain()
 	for (auto& imageView : m_swapChainImageViews)
 		vkDestroyImageView(m_device, imageView, nullptr);
 
+	if (m_options.headless)
+	{
+		for (size_t i = 0; i < m_swapChainImages.size(); i++)
+		{
+			vkDestroyImage(m_device, m_swapChainImages[i], nullptr);
+			m_allocator.Free(m_offscreenImagesAllocations[i]);
+		}
+		return;
+	}
 
 	vkDestroySwapchainKHR(m_device, m_swapChain, nullptr);
 }
 
-void VulkanTutorialApplication::RecreateSwapChain()
+bool VulkanTutorialApplication::RecreateSwapChain()
 {
 	int width = 0, height = 0;
 	glfwGetFramebufferSize(m_window, &width, &height);
-	while (width == 0 || height == 0)
+	if (width == 0 || height == 0)
 	{
-		glfwGetFramebufferSize(m_window, &width, &height);
-		glfwWaitEvents();
+		m_swapChainStale = true;
+		return false;
 	}
 	spdlog::info("Recreating SwapChain");
 
-	vkDeviceWaitIdle(m_device);
-	CleanupSwapChain();
+	// No device idle: frames in flight keep the old objects until their fences say they are done.
+	for (VkFramebuffer frameBuffer : m_swapChainFrameBuffers)
+		m_deletionQueue.PushFramebuffer(frameBuffer);
+	for (VkImageView imageView : m_swapChainImageViews)
+		m_deletionQueue.PushImageView(imageView);
+	m_swapChainFrameBuffers.clear();
+	m_swapChainImageViews.clear();
+	std::vector<VkCommandBuffer> commandBuffers;
+	for (const CachedCommandBuffer& cached : m_cachedCommandBuffers)
+		commandBuffers.push_back(cached.commandBuffer);
+	m_cachedCommandBuffers.clear();
+	m_deletionQueue.PushCommandBuffers(m_commandPool, std::move(commandBuffers));
+	// A present may still be using the swapchain, so it waits for ReleaseRetiredSwapChains.
+	m_retiredSwapChains.push_back({ m_swapChain, m_presentCount });
+
 	CreateSwapChain();
 	CreateImageViews();
 	CreateFrameBuffers();
+	m_commandsVersion++;
+	CreateCachedCommandBuffers();
+	m_swapChainStale = false;
+	return true;
 }
 
-VkShaderModule VulkanTutorialApplication::CreateShaderModule(std::vector<char>& code)
+// A frame's fence covers its submission but not the present that follows it on the present queue, so a
+// replaced swapchain is only handed to the deletion queue once its presents are known to be done. With
+// VK_EXT_swapchain_maintenance1 that is when the fences of all of them have signaled. Without it, the
+// fallback relies on presents completing in queue order: once an image that was presented on the
+// current swapchain is acquired again, every present queued before that one has finished, including
+// those on the older swapchains. Until then they stay alive, at worst until Cleanup.
+void VulkanTutorialApplication::ReleaseRetiredSwapChains(bool presentedImageAcquired)
 {
-	VkShaderModuleCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-	VkShaderModule shaderModule;
-	VK_CHECKERROR(
-		vkCreateShaderModule(m_device, &createInfo, nullptr, &shaderModule),
-		"Failed to create Shader Module"
-	)
-		spdlog::info("Created Shader Module");
-	return shaderModule;
+	auto presentsDone = [&](const RetiredSwapChain& retired)
+	{
+		if (!m_supportsPresentFences)
+			return presentedImageAcquired;
+		for (size_t i = 0; i < m_presentFences.size(); i++)
+		{
+			// A fence used by a later present was waited for before it was reused.
+			if (m_presentFenceNumbers[i] <= retired.lastPresent &&
+				vkGetFenceStatus(m_device, m_presentFences[i]) != VK_SUCCESS)
+				return false;
+		}
+		return true;
+	};
+
+	for (size_t i = 0; i < m_retiredSwapChains.size();)
+	{
+		if (!presentsDone(m_retiredSwapChains[i]))
+		{
+			i++;
+			continue;
+		}
+		// Frames recorded before the swap may still be rendering into its images.
+		m_deletionQueue.PushSwapChain(m_retiredSwapChains[i].swapChain);
+		m_retiredSwapChains.erase(m_retiredSwapChains.begin() + i);
+	}
 }
 
 void VulkanTutorialApplication::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
@@ -767,7 +928,10 @@ void VulkanTutorialApplication::RecordCommandBuffer(VkCommandBuffer commandBuffe
 		"Failed to begin recording command buffer"
 	)
 
-		VkRenderPassBeginInfo renderPassInfo {};
+	m_gpuProfiler.BeginFrame(commandBuffer, currentFrame);
+	m_gpuProfiler.BeginScope(commandBuffer, "frame");
+
+	VkRenderPassBeginInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = m_renderPass;
 	renderPassInfo.framebuffer = m_swapChainFrameBuffers[imageIndex];
@@ -776,9 +940,89 @@ void VulkanTutorialApplication::RecordCommandBuffer(VkCommandBuffer commandBuffe
 	VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
 	renderPassInfo.clearValueCount = 1;
 	renderPassInfo.pClearValues = &clearColor;
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	if (m_gpuCulling)
+	{
+		m_gpuProfiler.BeginScope(commandBuffer, "cull");
+		m_culler.RecordCull(commandBuffer, currentFrame, m_instances.GetCount(), m_meshLods, m_meshBoundingSphere,
+			glm::vec2(m_swapChainExtent.width, m_swapChainExtent.height) * 0.5f, m_options.lodErrorPixels);
+		m_gpuProfiler.EndScope(commandBuffer);
+	}
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+	// Still compiling: skip the draw this frame rather than stall on the driver.
+	VkPipeline pipeline = m_pipelineLibrary.Request(m_mainPipeline);
+	if (m_options.parallelRecording && m_options.recordMode != RecordMode::Cached && !m_gpuCulling &&
+		pipeline != VK_NULL_HANDLE)
+	{
+		std::vector<VkCommandBuffer> secondaries = RecordSecondaryDraws(imageIndex, pipeline);
+
+		m_gpuProfiler.BeginScope(commandBuffer, "render pass");
+		m_gpuProfiler.BeginScope(commandBuffer, "draws");
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+		vkCmdEndRenderPass(commandBuffer);
+		m_gpuProfiler.EndScope(commandBuffer);
+		m_gpuProfiler.EndScope(commandBuffer);
+	}
+	else
+	{
+		m_gpuProfiler.BeginScope(commandBuffer, "render pass");
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		m_gpuProfiler.BeginScope(commandBuffer, "draws");
+		RecordDraws(commandBuffer, pipeline, 0, m_instances.GetCount());
+		m_gpuProfiler.EndScope(commandBuffer);
+		vkCmdEndRenderPass(commandBuffer);
+		m_gpuProfiler.EndScope(commandBuffer);
+	}
+	m_gpuProfiler.EndScope(commandBuffer);
+
+	VK_CHECKERROR(
+		vkEndCommandBuffer(commandBuffer),
+		"Failed to record command buffer"
+	)
+}
+
+std::vector<VkCommandBuffer> VulkanTutorialApplication::RecordSecondaryDraws(uint32_t imageIndex, VkPipeline pipeline)
+{
+	uint32_t instanceCount = m_instances.GetCount();
+	uint32_t taskCount = std::min(m_threadCommandPools.GetThreadCount(),
+		(instanceCount + MIN_DRAWS_PER_RECORD_TASK - 1) / MIN_DRAWS_PER_RECORD_TASK);
+	if (!DrawsPerObject())
+		taskCount = 1;
+	std::vector<VkCommandBuffer> secondaries(taskCount);
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = m_renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = m_swapChainFrameBuffers[imageIndex];
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	m_threadCommandPools.BeginFrame(currentFrame);
+	m_jobs.ParallelFor(taskCount, [&](uint32_t task, uint32_t worker)
+	{
+		VkCommandBuffer commandBuffer = m_threadCommandPools.Acquire(currentFrame, worker,
+			VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(instanceCount) * task / taskCount);
+		uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(instanceCount) * (task + 1) / taskCount);
+		RecordDraws(commandBuffer, pipeline, first, last - first);
+		vkEndCommandBuffer(commandBuffer);
+		secondaries[task] = commandBuffer;
+	});
+	return secondaries;
+}
+
+void VulkanTutorialApplication::RecordDraws(VkCommandBuffer commandBuffer, VkPipeline pipeline,
+	uint32_t firstInstance, uint32_t instanceCount)
+{
+	if (pipeline == VK_NULL_HANDLE)
+		return;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
@@ -793,58 +1037,245 @@ void VulkanTutorialApplication::RecordCommandBuffer(VkCommandBuffer commandBuffe
 	scissor.extent = m_swapChainExtent;
 	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-	VkBuffer vertexBuffers[] = { m_vertexBuffer };
-	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+	VkBuffer vertexBuffers[] = { m_vertexBuffer, m_instances.GetBuffer(currentFrame) };
+	VkDeviceSize offsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+
+	vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, m_indexType);
+	// Binding 1 only matters on the uniform path, any valid offset will do for the others. The bindless set
+	// stays bound while the uniform path rebinds set 0 per draw.
+	uint32_t dynamicOffsets[] = { m_uniformOffset, m_uniformOffset };
+	VkDescriptorSet descriptorSets[] = { m_descriptorSet, m_bindless.GetSet() };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 2, descriptorSets, 2, dynamicOffsets);
 
-	vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT16);
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[currentFrame], 0, nullptr);
-	vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-	vkCmdEndRenderPass(commandBuffer);;
+	if (m_gpuCulling)
+	{
+		m_culler.RecordDraw(commandBuffer, currentFrame);
+	}
+	else if (m_transformPath == TransformPath::Uniform)
+	{
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			const MeshLod& lod = m_meshLods[m_instanceLods[firstInstance + i]];
+			dynamicOffsets[1] = m_objectUniformOffset + (firstInstance + i) * m_objectUniformStride;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1,
+				&m_descriptorSet, 2, dynamicOffsets);
+			vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, 0, 0);
+		}
+	}
+	else if (m_transformPath == TransformPath::PushConstant)
+	{
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			const MeshLod& lod = m_meshLods[m_instanceLods[firstInstance + i]];
+			ObjectConstants constants{ m_instances.GetTransform(firstInstance + i), 0 };
+			vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants),
+				&constants);
+			vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, 0, 0);
+		}
+	}
+	else if (m_options.perObjectDraws)
+	{
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			const MeshLod& lod = m_meshLods[m_instanceLods[firstInstance + i]];
+			vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, 0, firstInstance + i);
+		}
+	}
+	else
+	{
+		// One instanced draw per run of neighbors at the same LOD; the grid keeps such runs long.
+		uint32_t end = firstInstance + instanceCount;
+		for (uint32_t runStart = firstInstance; runStart < end;)
+		{
+			uint32_t runEnd = runStart + 1;
+			while (runEnd < end && m_instanceLods[runEnd] == m_instanceLods[runStart])
+				runEnd++;
+			const MeshLod& lod = m_meshLods[m_instanceLods[runStart]];
+			vkCmdDrawIndexed(commandBuffer, lod.indexCount, runEnd - runStart, lod.firstIndex, 0, runStart);
+			runStart = runEnd;
+		}
+	}
+}
+
+void VulkanTutorialApplication::SetTransformPath(TransformPath path)
+{
+	static const char* vertexShaders[] = { "res/vertex.spv", "res/vertex_object.spv", "res/vertex_push.spv" };
+	m_transformPath = path;
+	m_mainPipeline.vertexShader = vertexShaders[static_cast<int>(path)];
+	m_mainPipeline.vertexLayout = path == TransformPath::Instanced ? VertexLayout::Instanced : VertexLayout::Standard;
+	m_commandsVersion++;
+}
+
+bool VulkanTutorialApplication::DrawsPerObject() const
+{
+	return m_options.perObjectDraws || m_transformPath != TransformPath::Instanced;
+}
+
+VkCommandBuffer VulkanTutorialApplication::PrepareCommandBuffer(uint32_t imageIndex)
+{
+	switch (m_options.recordMode)
+	{
+	case RecordMode::Cached:
+	{
+		CachedCommandBuffer& cached = m_cachedCommandBuffers[currentFrame * m_swapChainImages.size() + imageIndex];
+		// A pipeline that finished compiling since the buffer was recorded changes the draws too.
+		VkPipeline pipeline = m_pipelineLibrary.Request(m_mainPipeline);
+		if (cached.version == m_commandsVersion && cached.pipeline == pipeline)
+		{
+			m_gpuProfiler.Resubmit(currentFrame);
+			return cached.commandBuffer;
+		}
+
+		vkResetCommandBuffer(cached.commandBuffer, 0);
+		RecordCommandBuffer(cached.commandBuffer, imageIndex);
+		cached.version = m_commandsVersion;
+		cached.pipeline = pipeline;
+		m_commandBufferRecords++;
+		return cached.commandBuffer;
+	}
+	case RecordMode::PoolReset:
+	{
+		m_framePools.BeginFrame(currentFrame);
+		VkCommandBuffer commandBuffer = m_framePools.Acquire(currentFrame, 0, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		RecordCommandBuffer(commandBuffer, imageIndex);
+		m_commandBufferRecords++;
+		return commandBuffer;
+	}
+	default:
+		vkResetCommandBuffer(m_commandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
+		RecordCommandBuffer(m_commandBuffers[currentFrame], imageIndex);
+		m_commandBufferRecords++;
+		return m_commandBuffers[currentFrame];
+	}
+}
+
+void VulkanTutorialApplication::CreateCachedCommandBuffers()
+{
+	if (m_options.recordMode != RecordMode::Cached)
+		return;
+
+	std::vector<VkCommandBuffer> commandBuffers(m_framesInFlight * m_swapChainImages.size());
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = m_commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
 	VK_CHECKERROR(
-		vkEndCommandBuffer(commandBuffer),
-		"Failed to record command buffer"
+		vkAllocateCommandBuffers(m_device, &allocInfo, commandBuffers.data()),
+		"Failed to create cached CommandBuffers"
 	)
+
+	m_cachedCommandBuffers.assign(commandBuffers.size(), {});
+	for (size_t i = 0; i < commandBuffers.size(); i++)
+		m_cachedCommandBuffers[i].commandBuffer = commandBuffers[i];
 }
 
 void VulkanTutorialApplication::DrawFrame()
 {
+	auto frameStart = std::chrono::high_resolution_clock::now();
 	vkWaitForFences(m_device, 1, &m_inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-
-	uint32_t imageIndex;
-	VkResult result = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, m_imageAvailableSemaphores[currentFrame],
-		VK_NULL_HANDLE, &imageIndex);
-
-	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	auto fenceSignaled = std::chrono::high_resolution_clock::now();
+	m_telemetry.fenceWait.Add(std::chrono::duration<double, std::milli>(fenceSignaled - frameStart).count());
+	// Submissions finish in order, so everything up to this frame's last one is done.
+	m_deletionQueue.Collect(m_frameSubmissions[currentFrame]);
+	if (m_swapChainStale && !RecreateSwapChain())
 	{
-		RecreateSwapChain();
+		// Minimized: nothing to draw into until the window is restored.
+		glfwWaitEvents();
 		return;
 	}
-	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+	PollFrameLatency();
+	m_gpuProfiler.Collect(currentFrame);
+	if (m_gpuCulling)
+		m_visibleInstances = m_culler.GetVisibleCount(currentFrame);
+
+	// Offscreen targets are owned per frame in flight, so there is nothing to acquire.
+	uint32_t imageIndex = currentFrame;
+	VkResult result;
+	if (!m_options.headless)
 	{
-		throw std::runtime_error("failed to acquire swap chain image!");
+		result = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, m_imageAvailableSemaphores[currentFrame],
+			VK_NULL_HANDLE, &imageIndex);
+		m_telemetry.acquireWait.Add(std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - fenceSignaled).count());
+
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			RecreateSwapChain();
+			return;
+		}
+		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+		{
+			throw std::runtime_error("failed to acquire swap chain image!");
+		}
+		if (!m_retiredSwapChains.empty())
+			ReleaseRetiredSwapChains(m_swapChainImagesPresented[imageIndex]);
 	}
+
+	auto recordStart = std::chrono::high_resolution_clock::now();
+	if (m_options.hotReload)
+	{
+		for (ShaderHotReload::CompiledShader& shader : m_shaderReload.TakeCompiled())
+			m_pipelineLibrary.ReloadShader(shader.spirvPath, std::move(shader.code));
+	}
+	// A frame boundary: cached command buffers see the swapped pipeline and re-record.
+	m_pipelineLibrary.BeginFrame();
 	UpdateUniformBuffer(currentFrame);
+	UpdateInstances();
+	VkCommandBuffer streamCommandBuffer = VK_NULL_HANDLE;
+	if (!m_textureHandles.empty())
+	{
+		for (uint32_t texture : m_textureHandles)
+			m_textures.Request(texture);
+		streamCommandBuffer = m_textures.RecordFrame(currentFrame);
+	}
 
 	vkResetFences(m_device, 1, &m_inFlightFences[currentFrame]);
 
-	vkResetCommandBuffer(m_commandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
-	RecordCommandBuffer(m_commandBuffers[currentFrame], imageIndex);
+	VkCommandBuffer commandBuffer = PrepareCommandBuffer(imageIndex);
+	m_telemetry.record.Add(std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - recordStart).count());
 
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	VkSemaphore waitSemaphores[] = { m_imageAvailableSemaphores[currentFrame] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
+	VkSemaphore waitSemaphores[2];
+	VkPipelineStageFlags waitStages[2];
+	uint64_t waitValues[2];
+	uint32_t waitCount = 0;
+	if (!m_options.headless)
+	{
+		waitSemaphores[waitCount] = m_imageAvailableSemaphores[currentFrame];
+		waitStages[waitCount] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		waitValues[waitCount++] = 0;
+	}
+	// Uploads run in their own submissions; the frame only waits for them on the GPU, never on the CPU.
+	if (m_uploader.GetLastSubmittedValue() > 0)
+	{
+		waitSemaphores[waitCount] = m_uploader.GetTimelineSemaphore();
+		waitStages[waitCount] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		waitValues[waitCount++] = m_uploader.GetLastSubmittedValue();
+	}
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = waitCount;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = waitCount;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &m_commandBuffers[currentFrame];
+	// Texture uploads go first in the same batch, so the frame samples what they wrote.
+	VkCommandBuffer commandBuffers[] = { streamCommandBuffer, commandBuffer };
+	bool streaming = streamCommandBuffer != VK_NULL_HANDLE;
+	submitInfo.commandBufferCount = streaming ? 2 : 1;
+	submitInfo.pCommandBuffers = streaming ? commandBuffers : &commandBuffer;
 
 	VkSemaphore signalSemaphores[] = { m_renderFinishedSemaphores[currentFrame] };
-	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.signalSemaphoreCount = m_options.headless ? 0 : 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
 	if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inFlightFences[currentFrame]) != VK_SUCCESS)
@@ -852,6 +1283,19 @@ void VulkanTutorialApplication::DrawFrame()
 		throw std::runtime_error("failed to submit draw command buffer!");
 	}
 
+	m_frameSubmissions[currentFrame] = m_deletionQueue.Submitted();
+
+	auto submitted = std::chrono::high_resolution_clock::now();
+	m_telemetry.cpuSubmit.Add(std::chrono::duration<double, std::milli>(submitted - recordStart).count());
+	m_frameSubmitTimes[currentFrame] = submitted;
+	m_frameLatencyPending[currentFrame] = true;
+
+	if (m_options.headless)
+	{
+		currentFrame = (currentFrame + 1) % m_framesInFlight;
+		return;
+	}
+
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -864,7 +1308,22 @@ void VulkanTutorialApplication::DrawFrame()
 
 	presentInfo.pImageIndices = &imageIndex;
 
+	VkSwapchainPresentFenceInfoEXT presentFenceInfo{};
+	if (m_supportsPresentFences)
+	{
+		// Usually long signaled, since the frame in this slot was presented frames in flight ago.
+		vkWaitForFences(m_device, 1, &m_presentFences[currentFrame], VK_TRUE, UINT64_MAX);
+		vkResetFences(m_device, 1, &m_presentFences[currentFrame]);
+		m_presentFenceNumbers[currentFrame] = m_presentCount + 1;
+		presentFenceInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT;
+		presentFenceInfo.swapchainCount = 1;
+		presentFenceInfo.pFences = &m_presentFences[currentFrame];
+		presentInfo.pNext = &presentFenceInfo;
+	}
+
 	result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+	m_presentCount++;
+	m_swapChainImagesPresented[imageIndex] = true;
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_framebufferResized)
 	{
@@ -876,11 +1335,26 @@ void VulkanTutorialApplication::DrawFrame()
 		throw std::runtime_error("failed to present swap chain image!");
 	}
 
-	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	currentFrame = (currentFrame + 1) % m_framesInFlight;
+}
+
+void VulkanTutorialApplication::PollFrameLatency()
+{
+	auto now = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < m_framesInFlight; i++)
+	{
+		if (!m_frameLatencyPending[i] || vkGetFenceStatus(m_device, m_inFlightFences[i]) != VK_SUCCESS)
+			continue;
+
+		m_telemetry.submitToGpuComplete.Add(
+			std::chrono::duration<double, std::milli>(now - m_frameSubmitTimes[i]).count());
+		m_frameLatencyPending[i] = false;
+	}
 }
 
 void VulkanTutorialApplication::CreateSyncObjects()
 {
+	m_frameSubmissions.assign(m_framesInFlight, 0);
 	VkSemaphoreCreateInfo semaphoreInfo{};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
@@ -889,11 +1363,22 @@ void VulkanTutorialApplication::CreateSyncObjects()
 	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
 
-	m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+	m_imageAvailableSemaphores.resize(m_framesInFlight);
+	m_renderFinishedSemaphores.resize(m_framesInFlight);
+	m_inFlightFences.resize(m_framesInFlight);
+	m_frameSubmitTimes.resize(m_framesInFlight);
+	m_frameLatencyPending.assign(m_framesInFlight, false);
+	m_presentFences.resize(m_supportsPresentFences ? m_framesInFlight : 0);
+	m_presentFenceNumbers.assign(m_presentFences.size(), 0);
+	for (VkFence& presentFence : m_presentFences)
+	{
+		VK_CHECKERROR(
+			vkCreateFence(m_device, &fenceInfo, nullptr, &presentFence),
+			"Failed to create Present Fence"
+		)
+	}
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	for (size_t i = 0; i < m_framesInFlight; i++)
 	{
 		VK_CHECKERROR(
 			vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]),
@@ -914,84 +1399,179 @@ void VulkanTutorialApplication::CreateSyncObjects()
 	spdlog::info("Created Sync Objects");
 }
 
+void VulkanTutorialApplication::PrepareLoadedMesh()
+{
+	const MeshFileHeader& header = m_meshFile.GetHeader();
+	const Vertex* vertices = static_cast<const Vertex*>(m_meshFile.GetVertices());
+	m_meshVertices.assign(vertices, vertices + header.vertexCount);
+	if (m_meshFile.GetIndexType() == VK_INDEX_TYPE_UINT16)
+	{
+		const uint16_t* indices = static_cast<const uint16_t*>(m_meshFile.GetIndices());
+		m_meshIndices.assign(indices, indices + header.indexCount);
+	}
+	else
+	{
+		const uint32_t* indices = static_cast<const uint32_t*>(m_meshFile.GetIndices());
+		m_meshIndices.assign(indices, indices + header.indexCount);
+	}
+
+	if (m_options.optimizeMesh)
+	{
+		m_meshOptimization = OptimizeMesh(m_meshVertices, m_meshIndices);
+		LogMeshOptimization(m_meshOptimization);
+	}
+
+	if (m_options.lodCount > 1)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		m_meshLods = BuildLodChain(m_meshVertices, m_meshIndices, m_options.lodCount);
+		spdlog::info("Built {} LODs in {:.1f} ms", m_meshLods.size(),
+			std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+		for (size_t i = 0; i < m_meshLods.size(); i++)
+			spdlog::info("  LOD {}: {} triangles, error {:.6f}", i, m_meshLods[i].indexCount / 3, m_meshLods[i].error);
+	}
+}
+
 void VulkanTutorialApplication::CreateVertexBuffer()
 {
+	const void* data = vertices.data();
 	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+	m_vertexCount = static_cast<uint32_t>(vertices.size());
+	glm::vec3 packCenter(0.0f);
+	float packScale = 1.0f;
+	glm::vec3 quadMin(std::numeric_limits<float>::max()), quadMax(std::numeric_limits<float>::lowest());
+	for (const Vertex& vertex : vertices)
+	{
+		quadMin = glm::min(quadMin, vertex.pos);
+		quadMax = glm::max(quadMax, vertex.pos);
+	}
+	m_meshBoundingSphere = glm::vec4((quadMin + quadMax) * 0.5f, glm::length(quadMax - quadMin) * 0.5f);
+	if (m_meshFile.IsOpen())
+	{
+		data = m_meshFile.GetVertices();
+		bufferSize = m_meshFile.GetVertexBytes();
+		m_vertexCount = m_meshFile.GetHeader().vertexCount;
+		if (!m_meshVertices.empty())
+		{
+			data = m_meshVertices.data();
+			bufferSize = sizeof(Vertex) * m_meshVertices.size();
+			m_vertexCount = static_cast<uint32_t>(m_meshVertices.size());
+		}
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	CreateBuffer(
-		bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, stagingBufferMemory
-	);
+		const MeshFileHeader& header = m_meshFile.GetHeader();
+		glm::vec3 boundsMin(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+		glm::vec3 boundsMax(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+		float radius = std::max(glm::length(boundsMax - boundsMin) * 0.5f, 1e-6f);
+		m_meshBoundingSphere = glm::vec4((boundsMin + boundsMax) * 0.5f, radius);
+		m_meshTransform = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / radius)) *
+			glm::translate(glm::mat4(1.0f), -(boundsMin + boundsMax) * 0.5f);
+		packCenter = (boundsMin + boundsMax) * 0.5f;
+		packScale = 1.0f / radius;
+	}
 
-	void* data;
-	vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, vertices.data(), bufferSize);
-	vkUnmapMemory(m_device, stagingBufferMemory);
+	std::vector<PackedVertex> packedVertices;
+	if (m_options.packedVertices)
+	{
+		// Packing applies the mesh's normalization, so half floats cover the unit sphere where they are
+		// most precise and the mesh transform has nothing left to do.
+		packedVertices.resize(m_vertexCount);
+		const Vertex* source = static_cast<const Vertex*>(data);
+		uint32_t taskCount = (m_vertexCount + VERTEX_PACK_BATCH - 1) / VERTEX_PACK_BATCH;
+		m_jobs.ParallelFor(taskCount, [&](uint32_t task, uint32_t)
+		{
+			size_t first = static_cast<size_t>(task) * VERTEX_PACK_BATCH;
+			size_t count = std::min<size_t>(VERTEX_PACK_BATCH, m_vertexCount - first);
+			PackVertices(source + first, count, packCenter, packScale, packedVertices.data() + first);
+		});
+		data = packedVertices.data();
+		bufferSize = sizeof(PackedVertex) * packedVertices.size();
+		m_meshBoundingSphere = glm::vec4((glm::vec3(m_meshBoundingSphere) - packCenter) * packScale,
+			m_meshBoundingSphere.w * packScale);
+		for (MeshLod& lod : m_meshLods)
+			lod.error *= packScale;
+		m_meshTransform = glm::mat4(1.0f);
+	}
+	m_vertexBufferBytes = bufferSize;
 
 	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferMemory);
-	CopyBuffer(stagingBuffer, m_vertexBuffer, bufferSize);
-	vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-	vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferAllocation);
+	m_uploader.Upload(m_vertexBuffer, 0, data, bufferSize);
 
-	spdlog::info("Created VertexBuffer");
+	spdlog::info("Created VertexBuffer: {} vertices, {} bytes", m_vertexCount, bufferSize);
 }
 
 void VulkanTutorialApplication::CreateIndexBuffer()
 {
+	const void* data = indices.data();
 	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+	m_indexType = VK_INDEX_TYPE_UINT16;
+	m_indexCount = static_cast<uint32_t>(indices.size());
+	if (m_meshFile.IsOpen())
+	{
+		data = m_meshFile.GetIndices();
+		bufferSize = m_meshFile.GetIndexBytes();
+		m_indexType = m_meshFile.GetIndexType();
+		m_indexCount = m_meshFile.GetHeader().indexCount;
+	}
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
-		stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices.data(), (size_t)bufferSize);
-	vkUnmapMemory(m_device, stagingBufferMemory);
+	std::vector<uint16_t> shortIndices;
+	if (!m_meshIndices.empty())
+	{
+		data = m_meshIndices.data();
+		bufferSize = sizeof(uint32_t) * m_meshIndices.size();
+		m_indexType = VK_INDEX_TYPE_UINT32;
+		m_indexCount = static_cast<uint32_t>(m_meshIndices.size());
+		if (m_vertexCount <= 65535)
+		{
+			shortIndices.assign(m_meshIndices.begin(), m_meshIndices.end());
+			data = shortIndices.data();
+			bufferSize = sizeof(uint16_t) * shortIndices.size();
+			m_indexType = VK_INDEX_TYPE_UINT16;
+		}
+	}
+	// Without LODs the whole buffer is LOD 0.
+	if (m_meshLods.empty())
+		m_meshLods = { { 0, m_indexCount, 0.0f } };
 
 	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexBufferMemory);
-
-	CopyBuffer(stagingBuffer, m_indexBuffer, bufferSize);
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexBufferAllocation);
+	m_uploader.Upload(m_indexBuffer, 0, data, bufferSize);
+}
 
-	vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-	vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+void VulkanTutorialApplication::CreateMaterials()
+{
+	// A single white material, so the scene keeps its vertex colors.
+	std::vector<MaterialData> materials = { { glm::vec4(1.0f) } };
+	VkDeviceSize bufferSize = sizeof(MaterialData) * materials.size();
+	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_materialBuffer, m_materialBufferAllocation);
+	m_uploader.Upload(m_materialBuffer, 0, materials.data(), bufferSize);
+	m_materialBufferIndex = m_bindless.RegisterBuffer(m_materialBuffer);
 }
 
 void VulkanTutorialApplication::CreateUniformBuffers()
 {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-	m_uniformBuffers.resize(bufferSize);
-	m_uniformBuffersMemory.resize(bufferSize);
-	m_uniformBuffersMapped.resize(bufferSize);
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	// The uniform path needs a slice per object on top of the frame constants.
+	VkDeviceSize bytesPerFrame = 256 * 1024;
+	if (m_options.transformPath == TransformPath::Uniform || m_options.transformBenchmark)
 	{
-		CreateBuffer(
-			bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			m_uniformBuffers[i], m_uniformBuffersMemory[i]
-		);
-		vkMapMemory(m_device, m_uniformBuffersMemory[i], 0, bufferSize, 0, &m_uniformBuffersMapped[i]);
+		uint32_t capacity = m_options.instanceSweep ? std::max(m_options.instanceCount, INSTANCE_SWEEP_MAX) :
+			m_options.instanceCount;
+		bytesPerFrame = std::max(bytesPerFrame, UNIFORM_MAX_ALIGNMENT * (capacity + 1));
 	}
+	m_uniformRing.Init(m_physicalDevice, m_device, m_allocator, m_framesInFlight, bytesPerFrame);
 }
 
 void VulkanTutorialApplication::CreateDescriptorPool()
 {
 	VkDescriptorPoolSize poolSize{};
-	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSize.descriptorCount = 2;
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = 1;
 	poolInfo.pPoolSizes = &poolSize;
-	poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolInfo.maxSets = 1;
 
 	VK_CHECKERROR(
 		vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool),
@@ -1002,35 +1582,35 @@ void VulkanTutorialApplication::CreateDescriptorPool()
 
 void VulkanTutorialApplication::CreateDescriptorSets()
 {
-	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, m_descriptorSetLayout);
+	// A single set for every frame: the frame's slice of the uniform ring is picked by the dynamic offset.
 	VkDescriptorSetAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.descriptorPool = m_descriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	allocInfo.pSetLayouts = layouts.data();
-	m_descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_descriptorSetLayout;
 
 	VK_CHECKERROR(
-		vkAllocateDescriptorSets(m_device, &allocInfo, m_descriptorSets.data()),
+		vkAllocateDescriptorSets(m_device, &allocInfo, &m_descriptorSet),
 		"Failed to allocate descirptor sets"
 	)
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = m_uniformBuffers[i];
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(UniformBufferObject);
-
-			VkWriteDescriptorSet descriptorWrite{};
-			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrite.dstSet = m_descriptorSets[i];
-			descriptorWrite.dstBinding = 0;
-			descriptorWrite.dstArrayElement = 0;
-			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrite.descriptorCount = 1;
-			descriptorWrite.pBufferInfo = &bufferInfo;
-
-			vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
-		}
+
+	VkDescriptorBufferInfo bufferInfos[] = {
+		{ m_uniformRing.GetBuffer(), 0, sizeof(UniformBufferObject) },
+		{ m_uniformRing.GetBuffer(), 0, sizeof(ObjectConstants) },
+	};
+	std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+	for (uint32_t i = 0; i < descriptorWrites.size(); i++)
+	{
+		descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[i].dstSet = m_descriptorSet;
+		descriptorWrites[i].dstBinding = i;
+		descriptorWrites[i].dstArrayElement = 0;
+		descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrites[i].descriptorCount = 1;
+		descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
 void VulkanTutorialApplication::UpdateUniformBuffer(uint32_t currentImage)
@@ -1039,30 +1619,168 @@ void VulkanTutorialApplication::UpdateUniformBuffer(uint32_t currentImage)
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
+	// Orbiting the camera backwards shows the same picture as spinning the scene, without touching any
+	// object's model matrix.
+	float angle = m_options.staticCamera ? 0.0f : time * glm::radians(90.0f);
+	glm::vec3 eye(glm::rotate(glm::mat4(1.0f), -angle, glm::vec3(0, 0, 1)) * glm::vec4(2.0f, 2.0f, 2.0f, 1.0f));
+	m_transforms.SetCamera(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	m_transforms.SetProjection(glm::radians(45.0f), m_swapChainExtent.width / (float)m_swapChainExtent.height, 0.1f, 10.0f);
+	m_viewProjectionChanged = m_transforms.UpdateViewProjection();
+
 	UniformBufferObject ubo{};
-	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0, 0, 1));
-	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.proj = glm::perspective(glm::radians(45.0f), m_swapChainExtent.width / (float)m_swapChainExtent.height, 0.1f, 10.0f);
-	memcpy(m_uniformBuffersMapped[currentFrame], &ubo, sizeof(ubo));
+	ubo.viewProj = m_transforms.GetViewProjection();
+	ubo.materialBuffer = m_materialBufferIndex;
+	// Frame constants are always the first push of the frame, so they sit at the frame's region base and the
+	// offset baked into cached command buffers stays valid.
+	m_uniformRing.BeginFrame(currentFrame);
+	m_uniformOffset = m_uniformRing.Push(ubo);
 }
 
-uint32_t VulkanTutorialApplication::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+void VulkanTutorialApplication::CreateInstances()
 {
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	uint32_t capacity = m_options.instanceCount;
+	if (m_options.instanceSweep)
+		capacity = std::max(capacity, INSTANCE_SWEEP_MAX);
+	m_instances.Init(m_device, m_allocator, m_framesInFlight, capacity);
+	m_instanceLods.assign(capacity, 0);
+	spdlog::info("Transform kernels: {}", TransformSystem::GetKernelName());
+	LayoutInstances(m_options.instanceCount);
+}
+
+void VulkanTutorialApplication::CreateGpuCulling()
+{
+	if (!m_supportsIndirectCount)
+	{
+		spdlog::warn("drawIndirectCount, multiDrawIndirect or drawIndirectFirstInstance not supported, "
+			"drawing with CPU-recorded draws");
+		return;
+	}
+
+	if (m_options.transformPath != TransformPath::Instanced || m_options.transformBenchmark)
 	{
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		spdlog::warn("GPU culling writes instanced draws, ignoring it on the {} transform path",
+			m_options.transformBenchmark ? "benchmarked" : "per-draw");
+		return;
+	}
+
+	std::vector<GpuCuller::Bindings> bindings(m_framesInFlight);
+	for (uint32_t i = 0; i < m_framesInFlight; i++)
+		bindings[i] = { m_instances.GetBuffer(i) };
+	m_culler.Init(m_device, m_allocator, m_pipelineCache.Get(), m_layoutCache, "res/cull.spv", bindings, m_instances.GetCapacity());
+	m_gpuCulling = true;
+}
+
+void VulkanTutorialApplication::LayoutInstances(uint32_t count)
+{
+	// A cube of side x side x side cells spanning [-1, 1], one mesh (already unit radius) per cell.
+	uint32_t side = 1;
+	while (side * side * side < count)
+		side++;
+	float cell = 2.0f / side;
+
+	m_instances.Resize(count);
+	m_transforms.Resize(count);
+	m_allTransformsDirty = true;
+	m_commandsVersion++;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		glm::vec3 coordinate(i % side, (i / side) % side, i / (side * side));
+		glm::vec3 center = -glm::vec3(1.0f) + (coordinate + 0.5f) * cell;
+		if (side == 1)
+			center = glm::vec3(0.0f);
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), center) *
+			glm::scale(glm::mat4(1.0f), glm::vec3(cell * 0.5f)) * m_meshTransform;
+		m_transforms.SetModel(i, transform);
+	}
+	m_nextDynamicInstance = 0;
+}
+
+void VulkanTutorialApplication::UpdateInstances()
+{
+	uint32_t count = m_instances.GetCount();
+	uint32_t dynamicCount = std::min(m_options.dynamicInstances, count);
+	glm::mat4 spin = glm::rotate(glm::mat4(1.0f), glm::radians(5.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	uint32_t dynamicFirst = m_nextDynamicInstance;
+	for (uint32_t i = 0; i < dynamicCount; i++)
+	{
+		uint32_t index = m_nextDynamicInstance;
+		m_nextDynamicInstance = (m_nextDynamicInstance + 1) % count;
+		m_transforms.SetModel(index, m_transforms.GetModel(index) * spin);
+	}
+
+	// A new camera changes every product; otherwise only the moved instances need one, and they are a
+	// single run from dynamicFirst that wraps around the end at most once.
+	bool transformsChanged = false;
+	bool lodsChanged = false;
+	if (m_viewProjectionChanged || m_allTransformsDirty)
+	{
+		m_transforms.ComputeModelViewProjection(0, count, m_instances.WriteTransforms(0, count));
+		lodsChanged = UpdateInstanceLods(0, count);
+		m_allTransformsDirty = false;
+		transformsChanged = true;
+	}
+	else if (dynamicCount > 0)
+	{
+		uint32_t headCount = std::min(dynamicCount, count - dynamicFirst);
+		m_transforms.ComputeModelViewProjection(dynamicFirst, headCount,
+			m_instances.WriteTransforms(dynamicFirst, headCount));
+		lodsChanged = UpdateInstanceLods(dynamicFirst, headCount);
+		if (dynamicCount > headCount)
 		{
-			return i;
+			m_transforms.ComputeModelViewProjection(0, dynamicCount - headCount,
+				m_instances.WriteTransforms(0, dynamicCount - headCount));
+			lodsChanged |= UpdateInstanceLods(0, dynamicCount - headCount);
 		}
+		transformsChanged = true;
+	}
+	// Draw ranges are baked into the command buffer as well.
+	if (lodsChanged)
+		m_commandsVersion++;
+
+	m_instanceBytesWritten += m_instances.Sync(currentFrame);
+	// Push constants are baked into the command buffer, so new matrices mean recording it again.
+	if (m_transformPath == TransformPath::PushConstant && transformsChanged)
+		m_commandsVersion++;
+	if (m_transformPath == TransformPath::Uniform)
+		UpdateObjectConstants();
+}
+
+bool VulkanTutorialApplication::UpdateInstanceLods(uint32_t first, uint32_t count)
+{
+	// The cull shader selects LODs itself.
+	if (m_meshLods.size() < 2 || m_gpuCulling)
+		return false;
+
+	glm::vec2 viewportHalfSize = glm::vec2(m_swapChainExtent.width, m_swapChainExtent.height) * 0.5f;
+	bool changed = false;
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		uint8_t lod = static_cast<uint8_t>(SelectLod(m_meshLods, m_instances.GetTransform(i), m_meshBoundingSphere,
+			viewportHalfSize, m_options.lodErrorPixels));
+		changed |= lod != m_instanceLods[i];
+		m_instanceLods[i] = lod;
+	}
+	return changed;
+}
+
+void VulkanTutorialApplication::UpdateObjectConstants()
+{
+	// Pushed right after the frame constants and in instance order, so the offsets are the same every time
+	// the frame comes around and cached command buffers can keep using them.
+	uint32_t count = m_instances.GetCount();
+	m_objectUniformStride = m_uniformRing.GetStride(sizeof(ObjectConstants));
+	for (uint32_t i = 0; i < count; i++)
+	{
+		ObjectConstants constants{ m_instances.GetTransform(i), 0 };
+		uint32_t offset = m_uniformRing.Push(constants);
+		if (i == 0)
+			m_objectUniformOffset = offset;
 	}
-	throw std::runtime_error("failed to find suitable memory type!");
 }
 
 void VulkanTutorialApplication::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
 	VkMemoryPropertyFlags properties, VkBuffer& buffer,
-	VkDeviceMemory& bufferMemory)
+	Allocation& allocation)
 {
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1078,119 +1796,244 @@ void VulkanTutorialApplication::CreateBuffer(VkDeviceSize size, VkBufferUsageFla
 		VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
-	VK_CHECKERROR(
-		vkAllocateMemory(m_device, &allocInfo, nullptr, &bufferMemory),
-		"Failed to allocate buffer memory"
-	)
-		vkBindBufferMemory(m_device, buffer, bufferMemory, 0);
+	allocation = m_allocator.Allocate(memRequirements, properties, AllocationKind::Linear);
+	vkBindBufferMemory(m_device, buffer, allocation.memory, allocation.offset);
 }
 
-
-void VulkanTutorialApplication::CopyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size)
+void VulkanTutorialApplication::DestroyBuffer(VkBuffer buffer, const Allocation& allocation)
 {
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = m_commandPool;
-	allocInfo.commandBufferCount = 1;
-	VkCommandBuffer commandBuffer;
-	vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer);
-
-
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0;
-	copyRegion.dstOffset = 0;
-	copyRegion.size = size;
-	vkCmdCopyBuffer(commandBuffer, src, dst, 1, &copyRegion);
-
-	vkEndCommandBuffer(commandBuffer);
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(m_graphicsQueue);
-	vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
+	vkDestroyBuffer(m_device, buffer, nullptr);
+	m_allocator.Free(allocation);
 }
 
+
 void VulkanTutorialApplication::CreateDescriptorSetLayout()
 {
-	VkDescriptorSetLayoutBinding uboLayoutBinding{};
-	uboLayoutBinding.binding = 0;
-	uboLayoutBinding.descriptorCount = 1;
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	uboLayoutBinding.pImmutableSamplers = nullptr;
-	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-	VkDescriptorSetLayoutCreateInfo layoutInfo{};
-	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = 1;
-	layoutInfo.pBindings = &uboLayoutBinding;
+	// All main pipelines share one layout, so descriptor sets and push constants stay bound when the
+	// transform path switches pipelines.
+	std::vector<ShaderReflection> shaders;
+	for (const char* path : { "res/vertex.spv", "res/vertex_object.spv", "res/vertex_push.spv", "res/fragment.spv" })
+	{
+		std::vector<char> code = IO::ReadFile(path);
+		shaders.push_back(ReflectSpirv(code.data(), code.size()));
+	}
 
-	if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create descriptor set layout!");
+	// Set 1 is the bindless set, whose update-after-bind flags reflection cannot see. Frame and object
+	// constants come from the uniform ring at dynamic offsets.
+	m_layoutCache.Init(m_device);
+	LayoutCache::ProgramLayout layout = m_layoutCache.GetProgramLayout(shaders, { { 1, m_bindless.GetSetLayout() } },
+		true);
+	if (layout.setLayouts.size() != 2)
+	{
+		throw std::runtime_error("The main shaders must use exactly descriptor sets 0 and 1");
 	}
+	m_descriptorSetLayout = layout.setLayouts[0];
+	m_pipelineLayout = layout.pipelineLayout;
 	spdlog::info("Created DescriptorSetlayout");
 }
 
 void VulkanTutorialApplication::MainLoop()
 {
+	if (m_options.headless && m_options.instanceSweep)
+	{
+		RunInstanceSweep();
+		return;
+	}
+
+	if (m_options.headless && m_options.transformBenchmark)
+	{
+		RunTransformBenchmark();
+		return;
+	}
+
+	if (m_options.headless)
+	{
+		spdlog::info("Rendering {} headless frames", m_options.benchmarkFrames);
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < m_options.benchmarkFrames; i++)
+		{
+			DrawFrame();
+		}
+		vkDeviceWaitIdle(m_device);
+		double totalSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+		for (uint32_t i = 0; i < m_framesInFlight; i++)
+			m_gpuProfiler.Collect(i);
+		PollFrameLatency();
+		m_telemetry.Log();
+		m_gpuProfiler.Log();
+		WriteBenchmarkReport(totalSeconds);
+		return;
+	}
+
+	uint64_t frame = 0;
 	while (!glfwWindowShouldClose(m_window))
 	{
 		glfwPollEvents();
 		DrawFrame();
+		if (++frame % TELEMETRY_LOG_INTERVAL == 0)
+		{
+			m_telemetry.Log();
+			m_gpuProfiler.Log();
+		}
 	}
 	vkDeviceWaitIdle(m_device);
+	for (uint32_t i = 0; i < m_framesInFlight; i++)
+		m_gpuProfiler.Collect(i);
+	m_telemetry.Log();
+	m_gpuProfiler.Log();
 }
 
-void VulkanTutorialApplication::Cleanup()
+double VulkanTutorialApplication::RunBenchmarkFrames()
 {
-	CleanupSwapChain();
-	vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
-	vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+	m_telemetry.Clear();
+	m_gpuProfiler.ResetStatistics();
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < m_options.benchmarkFrames; i++)
 	{
-		vkDestroyBuffer(m_device, m_uniformBuffers[i], nullptr);
-		vkFreeMemory(m_device, m_uniformBuffersMemory[i], nullptr);
+		DrawFrame();
 	}
-	vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
-	vkDestroyBuffer(m_device, m_vertexBuffer, nullptr);
-	vkFreeMemory(m_device, m_vertexBufferMemory, nullptr);
+	vkDeviceWaitIdle(m_device);
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	for (uint32_t i = 0; i < m_framesInFlight; i++)
+		m_gpuProfiler.Collect(i);
+	return seconds;
+}
 
-	vkDestroyBuffer(m_device, m_indexBuffer, nullptr);
-	vkFreeMemory(m_device, m_indexBufferMemory, nullptr);
+void VulkanTutorialApplication::RunInstanceSweep()
+{
+	std::vector<std::string> results;
+	double totalSeconds = 0.0;
+	for (uint32_t count = 1; count <= INSTANCE_SWEEP_MAX; count *= 10)
+	{
+		vkDeviceWaitIdle(m_device);
+		for (uint32_t i = 0; i < m_framesInFlight; i++)
+			m_gpuProfiler.Collect(i);
+		LayoutInstances(count);
+
+		double seconds = RunBenchmarkFrames();
+		totalSeconds += seconds;
+
+		double fps = seconds > 0.0 ? m_options.benchmarkFrames / seconds : 0.0;
+		MetricSummary cpu = m_telemetry.cpuSubmit.Summarize();
+		MetricSummary gpu = m_gpuProfiler.GetSummary("draws");
+		double instancesPerSecond = gpu.avg > 0.0 ? count / (gpu.avg / 1000.0) : 0.0;
+		spdlog::info("{:>6} instances: {:8.1f} fps, cpu submit {:.3f} ms, gpu draws {:.3f} ms, {:.2f} M instances/s",
+			count, fps, cpu.avg, gpu.avg, instancesPerSecond / 1e6);
+		results.push_back(fmt::format("{{ \"instances\": {}, \"visible\": {}, \"fps\": {:.2f}, "
+			"\"cpu_submit_ms\": {}, \"gpu_draws_ms\": {}, \"instances_per_second\": {:.0f} }}", count,
+			m_gpuCulling ? m_visibleInstances : count, fps, SummaryToJson(cpu), SummaryToJson(gpu), instancesPerSecond));
+	}
 
+	m_instanceSweepJson = "[\n    " + fmt::format("{}", fmt::join(results, ",\n    ")) + "\n  ]";
+	m_telemetry.Log();
+	m_gpuProfiler.Log();
+	WriteBenchmarkReport(totalSeconds);
+}
 
-	vkDestroyPipeline(m_device, m_graphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+void VulkanTutorialApplication::RunTransformBenchmark()
+{
+	static const char* pathNames[] = { "instanced", "ubo", "push" };
+	std::vector<std::string> results;
+	double totalSeconds = 0.0;
+	for (TransformPath path : { TransformPath::Instanced, TransformPath::Uniform, TransformPath::PushConstant })
+	{
+		vkDeviceWaitIdle(m_device);
+		for (uint32_t i = 0; i < m_framesInFlight; i++)
+			m_gpuProfiler.Collect(i);
+		SetTransformPath(path);
+		m_pipelineLibrary.RequestBlocking(m_mainPipeline);
+
+		double seconds = RunBenchmarkFrames();
+		totalSeconds += seconds;
+
+		double fps = seconds > 0.0 ? m_options.benchmarkFrames / seconds : 0.0;
+		MetricSummary record = m_telemetry.record.Summarize();
+		MetricSummary cpu = m_telemetry.cpuSubmit.Summarize();
+		MetricSummary gpu = m_gpuProfiler.GetSummary("draws");
+		const char* name = pathNames[static_cast<int>(path)];
+		spdlog::info("{:>9} path, {} draws: {:8.1f} fps, record {:.3f} ms, cpu submit {:.3f} ms, gpu draws {:.3f} ms",
+			name, DrawsPerObject() ? m_instances.GetCount() : 1, fps, record.avg, cpu.avg, gpu.avg);
+		results.push_back(fmt::format("{{ \"path\": \"{}\", \"fps\": {:.2f}, \"record_ms\": {}, "
+			"\"cpu_submit_ms\": {}, \"gpu_draws_ms\": {} }}", name, fps, SummaryToJson(record), SummaryToJson(cpu),
+			SummaryToJson(gpu)));
+	}
+
+	m_transformBenchmarkJson = "[\n    " + fmt::format("{}", fmt::join(results, ",\n    ")) + "\n  ]";
+	m_telemetry.Log();
+	m_gpuProfiler.Log();
+	WriteBenchmarkReport(totalSeconds);
+}
+
+void VulkanTutorialApplication::Cleanup()
+{
+	// First, while everything a queued destroy function refers to still exists.
+	m_deletionQueue.Destroy();
+	// The device is idle, but that does not cover presents, which only their fences can tell about.
+	if (!m_presentFences.empty())
+	{
+		vkWaitForFences(m_device, static_cast<uint32_t>(m_presentFences.size()), m_presentFences.data(), VK_TRUE,
+			UINT64_MAX);
+	}
+	for (const RetiredSwapChain& retired : m_retiredSwapChains)
+		vkDestroySwapchainKHR(m_device, retired.swapChain, nullptr);
+	m_retiredSwapChains.clear();
+	CleanupSwapChain();
+	vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+
+	m_uniformRing.Destroy();
+	DestroyBuffer(m_vertexBuffer, m_vertexBufferAllocation);
+	DestroyBuffer(m_indexBuffer, m_indexBufferAllocation);
+	DestroyBuffer(m_materialBuffer, m_materialBufferAllocation);
+	if (!m_options.texturePaths.empty())
+		m_textures.Destroy();
+	m_bindless.Destroy();
+	if (m_gpuCulling)
+		m_culler.Destroy();
+	m_instances.Destroy();
+
+
+	if (m_options.hotReload)
+		m_shaderReload.Destroy();
+	m_pipelineLibrary.Destroy();
+	m_pipelineCache.Save();
+	m_pipelineCache.Destroy();
+	m_threadCommandPools.Destroy();
+	m_framePools.Destroy();
+	m_jobs.Shutdown();
+	m_layoutCache.Destroy();
 
 	vkDestroyRenderPass(m_device, m_renderPass, nullptr);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	for (size_t i = 0; i < m_framesInFlight; i++)
 	{
 		vkDestroySemaphore(m_device, m_renderFinishedSemaphores[i], nullptr);
 		vkDestroySemaphore(m_device, m_imageAvailableSemaphores[i], nullptr);
 		vkDestroyFence(m_device, m_inFlightFences[i], nullptr);
 	}
+	for (VkFence presentFence : m_presentFences)
+		vkDestroyFence(m_device, presentFence, nullptr);
+
+	if (!m_options.gpuTracePath.empty())
+		m_gpuProfiler.WriteChromeTrace(m_options.gpuTracePath);
+	m_gpuProfiler.Destroy();
 
 	vkDestroyCommandPool(m_device, m_commandPool, nullptr);
 
+	m_uploader.Destroy();
+	m_allocator.LogStatistics();
+	m_allocator.Destroy();
 	vkDestroyDevice(m_device, nullptr);
 
 	DestroyDebugMessenger();
 
+	if (m_options.headless)
+	{
+		vkDestroyInstance(m_instance, nullptr);
+		return;
+	}
+
 	vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
 	vkDestroyInstance(m_instance, nullptr);
 
@@ -1198,6 +2041,89 @@ void VulkanTutorialApplication::Cleanup()
 	glfwTerminate();
 }
 
+void VulkanTutorialApplication::WriteBenchmarkReport(double totalSeconds)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+	double fps = totalSeconds > 0.0 ? m_options.benchmarkFrames / totalSeconds : 0.0;
+
+	std::ofstream report(m_options.reportPath);
+	if (!report.is_open())
+	{
+		throw std::runtime_error("Failed to open benchmark report " + m_options.reportPath);
+	}
+	report << "{\n";
+	report << fmt::format("  \"device\": \"{}\",\n", properties.deviceName);
+	report << fmt::format("  \"extent\": [{}, {}],\n", m_swapChainExtent.width, m_swapChainExtent.height);
+	report << fmt::format("  \"startup\": {{ \"pipeline_cache\": \"{}\", \"init_ms\": {:.4f}, "
+		"\"pipeline_ms\": {:.4f} }},\n", m_pipelineCache.WasLoaded() ? "warm" : "cold", m_initMilliseconds,
+		m_pipelineMilliseconds);
+	report << fmt::format("  \"frames\": {},\n", m_options.benchmarkFrames);
+	report << fmt::format("  \"total_seconds\": {:.4f},\n", totalSeconds);
+	report << fmt::format("  \"fps\": {:.2f},\n", fps);
+	report << fmt::format("  \"frames_in_flight\": {},\n", m_framesInFlight);
+	report << fmt::format("  \"cpu_submit_ms\": {},\n", SummaryToJson(m_telemetry.cpuSubmit.Summarize()));
+	report << fmt::format("  \"gpu_ms\": {},\n", SummaryToJson(m_gpuProfiler.GetSummary("frame")));
+	report << fmt::format("  \"gpu_scopes_ms\": {},\n", m_gpuProfiler.ToJson());
+	report << fmt::format("  \"telemetry\": {},\n", m_telemetry.ToJson());
+	report << fmt::format("  \"instances\": {{ \"count\": {}, \"dynamic\": {}, \"bytes_written\": {}, "
+		"\"gpu_culling\": {}, \"visible\": {}, \"static_camera\": {}, \"transform_kernel\": \"{}\" }},\n",
+		m_instances.GetCount(), m_options.dynamicInstances, m_instanceBytesWritten, m_gpuCulling,
+		m_gpuCulling ? m_visibleInstances : m_instances.GetCount(), m_options.staticCamera,
+		TransformSystem::GetKernelName());
+	report << fmt::format("  \"mesh\": {{ \"vertices\": {}, \"indices\": {}, \"packed_vertices\": {}, "
+		"\"vertex_bytes\": {} }},\n", m_vertexCount, m_indexCount, m_options.packedVertices, m_vertexBufferBytes);
+	// Instances per LOD are only known for CPU-recorded draws, the cull shader selects its own.
+	std::vector<uint32_t> lodInstances(m_meshLods.size(), 0);
+	for (uint32_t i = 0; i < m_instances.GetCount(); i++)
+		lodInstances[m_instanceLods[i]]++;
+	std::string lodsJson;
+	for (size_t i = 0; i < m_meshLods.size(); i++)
+	{
+		lodsJson += fmt::format("{}{{ \"triangles\": {}, \"error\": {:.6f}, \"instances\": {} }}", i == 0 ? "" : ", ",
+			m_meshLods[i].indexCount / 3, m_meshLods[i].error,
+			m_gpuCulling ? std::string("null") : std::to_string(lodInstances[i]));
+	}
+	report << fmt::format("  \"lods\": {{ \"error_pixels\": {}, \"levels\": [{}] }},\n", m_options.lodErrorPixels,
+		lodsJson);
+	if (!m_textureHandles.empty())
+	{
+		TextureStreamer::Statistics textures = m_textures.GetStatistics();
+		report << fmt::format("  \"textures\": {{ \"count\": {}, \"resident\": {}, \"fully_resident\": {}, "
+			"\"generated_mip_chains\": {}, \"resident_bytes\": {}, \"budget_bytes\": {}, \"uploaded_bytes\": {}, "
+			"\"evictions\": {} }},\n", textures.textures, textures.residentTextures, textures.fullyResidentTextures,
+			textures.generatedMipChains, textures.residentBytes, textures.budgetBytes, textures.uploadedBytes,
+			textures.evictions);
+	}
+	if (m_options.optimizeMesh && m_meshOptimization.verticesBefore != 0)
+	{
+		report << fmt::format("  \"mesh_optimization\": {{ \"ms\": {:.3f}, \"vertices_before\": {}, "
+			"\"vertices_after\": {}, \"acmr_before\": {:.4f}, \"acmr_after\": {:.4f}, \"atvr_before\": {:.4f}, "
+			"\"atvr_after\": {:.4f} }},\n", m_meshOptimization.milliseconds, m_meshOptimization.verticesBefore,
+			m_meshOptimization.verticesAfter, m_meshOptimization.before.acmr, m_meshOptimization.after.acmr,
+			m_meshOptimization.before.atvr, m_meshOptimization.after.atvr);
+	}
+	static const char* recordModes[] = { "rerecord", "cached", "pool-reset" };
+	static const char* transformPaths[] = { "instanced", "ubo", "push" };
+	report << fmt::format("  \"recording\": {{ \"mode\": \"{}\", \"parallel\": {}, \"threads\": {}, "
+		"\"per_object_draws\": {}, \"transform_path\": \"{}\", \"records\": {} }},\n",
+		recordModes[static_cast<int>(m_options.recordMode)], m_options.parallelRecording,
+		m_options.parallelRecording ? m_threadCommandPools.GetThreadCount() : 1, DrawsPerObject(),
+		transformPaths[static_cast<int>(m_transformPath)], m_commandBufferRecords);
+	if (!m_instanceSweepJson.empty())
+		report << fmt::format("  \"instance_sweep\": {},\n", m_instanceSweepJson);
+	if (!m_transformBenchmarkJson.empty())
+		report << fmt::format("  \"transform_benchmark\": {},\n", m_transformBenchmarkJson);
+	AllocatorStatistics memory = m_allocator.GetStatistics();
+	report << fmt::format("  \"memory\": {{ \"blocks\": {}, \"allocations\": {}, \"block_bytes\": {}, "
+		"\"used_bytes\": {}, \"fragmentation\": {:.4f} }}\n", memory.blockCount, memory.allocationCount,
+		memory.blockBytes, memory.usedBytes, memory.fragmentation);
+	report << "}\n";
+
+	spdlog::info("{} frames in {:.3f}s ({:.1f} fps) on {}, report written to {}", m_options.benchmarkFrames,
+		totalSeconds, fps, properties.deviceName, m_options.reportPath);
+}
+
 void VulkanTutorialApplication::DestroyDebugMessenger()
 {
 	if (!m_enableValidationLayers)
@@ -1224,12 +2150,166 @@ VkBool32 VulkanTutorialApplication::DebugCallback(VkDebugUtilsMessageSeverityFla
 }
 
 
+void VulkanTutorialApplication::ParseCommandLine(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--headless")
+		{
+			m_options.headless = true;
+		}
+		else if (arg == "--frames" && hasValue)
+		{
+			m_options.benchmarkFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--report" && hasValue)
+		{
+			m_options.reportPath = argv[++i];
+		}
+		else if (arg == "--pipeline-cache" && hasValue)
+		{
+			m_options.pipelineCachePath = argv[++i];
+		}
+		else if (arg == "--no-pipeline-cache")
+		{
+			m_options.pipelineCachePath.clear();
+		}
+		else if (arg == "--threads" && hasValue)
+		{
+			m_options.workerThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--mesh" && hasValue)
+		{
+			m_options.meshPath = argv[++i];
+		}
+		else if (arg == "--convert-obj" && i + 2 < argc)
+		{
+			m_options.convertObjPath = argv[++i];
+			m_options.meshPath = argv[++i];
+		}
+		else if (arg == "--instances" && hasValue)
+		{
+			m_options.instanceCount = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (arg == "--dynamic-instances" && hasValue)
+		{
+			m_options.dynamicInstances = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--instance-sweep")
+		{
+			m_options.instanceSweep = true;
+		}
+		else if (arg == "--per-object-draws")
+		{
+			m_options.perObjectDraws = true;
+		}
+		else if (arg == "--parallel-recording")
+		{
+			m_options.parallelRecording = true;
+		}
+		else if (arg == "--record-mode" && hasValue)
+		{
+			std::string mode = argv[++i];
+			if (mode == "rerecord")
+				m_options.recordMode = RecordMode::Rerecord;
+			else if (mode == "cached")
+				m_options.recordMode = RecordMode::Cached;
+			else if (mode == "pool-reset")
+				m_options.recordMode = RecordMode::PoolReset;
+			else
+				throw std::runtime_error("Unknown record mode " + mode);
+		}
+		else if (arg == "--transform-path" && hasValue)
+		{
+			std::string path = argv[++i];
+			if (path == "instanced")
+				m_options.transformPath = TransformPath::Instanced;
+			else if (path == "ubo")
+				m_options.transformPath = TransformPath::Uniform;
+			else if (path == "push")
+				m_options.transformPath = TransformPath::PushConstant;
+			else
+				throw std::runtime_error("Unknown transform path " + path);
+		}
+		else if (arg == "--lods" && hasValue)
+		{
+			m_options.lodCount = std::clamp(static_cast<uint32_t>(std::stoul(argv[++i])), 1u, MAX_MESH_LODS);
+		}
+		else if (arg == "--lod-error" && hasValue)
+		{
+			m_options.lodErrorPixels = std::stof(argv[++i]);
+		}
+		else if (arg == "--texture" && hasValue)
+		{
+			m_options.texturePaths.push_back(argv[++i]);
+		}
+		else if (arg == "--texture-budget" && hasValue)
+		{
+			m_options.textureBudgetMiB = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--optimize-mesh")
+		{
+			m_options.optimizeMesh = true;
+		}
+		else if (arg == "--packed-vertices")
+		{
+			m_options.packedVertices = true;
+		}
+		else if (arg == "--static-camera")
+		{
+			m_options.staticCamera = true;
+		}
+		else if (arg == "--transform-benchmark")
+		{
+			m_options.transformBenchmark = true;
+		}
+		else if (arg == "--hot-reload")
+		{
+			m_options.hotReload = true;
+		}
+		else if (arg == "--gpu-culling")
+		{
+			m_options.gpuCulling = true;
+		}
+		else if (arg == "--gpu-trace" && hasValue)
+		{
+			m_options.gpuTracePath = argv[++i];
+		}
+		else if (arg == "--frames-in-flight" && hasValue)
+		{
+			m_options.framesInFlight = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (arg == "--present-mode" && hasValue)
+		{
+			std::string mode = argv[++i];
+			if (mode == "mailbox")
+				m_options.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+			else if (mode == "fifo")
+				m_options.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+			else if (mode == "fifo-relaxed")
+				m_options.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+			else if (mode == "immediate")
+				m_options.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			else
+				throw std::runtime_error("Unknown present mode " + mode);
+		}
+		else
+		{
+			throw std::runtime_error("Unknown argument " + arg);
+		}
+	}
+}
+
 int main(int argc, char* argv[])
 {
 	VulkanTutorialApplication app;
 
 	try
 	{
+		app.ParseCommandLine(argc, argv);
 		app.Run();
 	}
 	catch (std::exception& e)
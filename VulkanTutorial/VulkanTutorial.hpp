@@ -10,6 +10,28 @@
 #include <limits>
 #include <algorithm>
 #include <chrono>
+#include <string>
+#include "Allocator.hpp"
+#include "StagingUploader.hpp"
+#include "PipelineCache.hpp"
+#include "PipelineLibrary.hpp"
+#include "JobSystem.hpp"
+#include "Telemetry.hpp"
+#include "GpuProfiler.hpp"
+#include "Mesh.hpp"
+#include "InstanceBuffer.hpp"
+#include "GpuCuller.hpp"
+#include "ThreadCommandPools.hpp"
+#include "UniformRing.hpp"
+#include "TransformSystem.hpp"
+#include "BindlessDescriptors.hpp"
+#include "VertexFormat.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include "TextureStreamer.hpp"
+#include "ShaderHotReload.hpp"
+#include "LayoutCache.hpp"
+#include "DeletionQueue.hpp"
 
 
 #define LOG_INFO(msg) spdlog::info("{}:{} {}", __FILE__, __LINE__, std::string(msg));
@@ -29,10 +51,88 @@ namespace IO
 }
 
 
+// How the per-frame primary command buffer is produced.
+enum class RecordMode
+{
+	// Reset the frame's command buffer and record it again every frame.
+	Rerecord,
+	// Record once per (frame in flight, swapchain image) and replay until the commands would change.
+	Cached,
+	// Reset the frame's whole command pool and record into a fresh buffer from it.
+	PoolReset
+};
+
+// Where the vertex shader gets each object's model matrix from.
+enum class TransformPath
+{
+	// Per-instance vertex binding, so every object can share one instanced draw.
+	Instanced,
+	// One slice of the uniform ring per object, selected with a dynamic offset before each draw.
+	Uniform,
+	// vkCmdPushConstants before each draw.
+	PushConstant
+};
+
+struct ApplicationOptions
+{
+	// Renders into offscreen images instead of a window surface, so the app runs without a display
+	// (e.g. on CI machines with a software ICD such as lavapipe).
+	bool headless = false;
+	uint32_t benchmarkFrames = 1000;
+	std::string reportPath = "benchmark.json";
+	// Empty disables loading and saving the pipeline cache.
+	std::string pipelineCachePath = "pipeline_cache.bin";
+	// Worker threads for pipeline compilation, 0 picks one per spare hardware thread.
+	uint32_t workerThreads = 0;
+	// More frames in flight hide CPU/GPU jitter at the cost of input latency.
+	uint32_t framesInFlight = 2;
+	// Falls back to FIFO, which every surface supports, when the surface lacks it.
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+	// Chrome trace of every GPU scope, written on exit. Empty disables it.
+	std::string gpuTracePath;
+	// .vmesh file to draw instead of the built-in quad.
+	std::string meshPath;
+	// Runs the mesh optimizer on meshPath after loading it. Converted meshes are always optimized.
+	bool optimizeMesh = false;
+	// LODs generated for meshPath, including full resolution, and the screen-space error in pixels an
+	// object's LOD may have.
+	uint32_t lodCount = 1;
+	float lodErrorPixels = 1.0f;
+	// DDS/KTX2 textures streamed into a budget of textureBudgetMiB of VRAM, all requested every frame.
+	std::vector<std::string> texturePaths;
+	uint32_t textureBudgetMiB = 256;
+	// When set, converts objPath to meshPath and exits without rendering.
+	std::string convertObjPath;
+	// Objects drawn, laid out on a grid, and how many of them are re-transformed every frame.
+	uint32_t instanceCount = 1;
+	uint32_t dynamicInstances = 0;
+	// Headless only: renders benchmarkFrames frames at every power of ten from 1 to INSTANCE_SWEEP_MAX instances.
+	bool instanceSweep = false;
+	// Cull instances against the frustum in a compute pass and draw the survivors with one indirect draw.
+	bool gpuCulling = false;
+	// One vkCmdDrawIndexed per instance instead of a single instanced draw.
+	bool perObjectDraws = false;
+	// Recompile res/*.glsl when they change and swap the affected pipelines in while running.
+	bool hotReload = false;
+	// Record the draws into secondary command buffers on every job system thread.
+	bool parallelRecording = false;
+	RecordMode recordMode = RecordMode::Rerecord;
+	// Uniform and PushConstant issue one draw per object.
+	TransformPath transformPath = TransformPath::Instanced;
+	// Uploads vertices as half-float positions and UNORM8 colors instead of float32.
+	bool packedVertices = false;
+	// Keeps the camera still, so object matrices are only recomputed for instances that move.
+	bool staticCamera = false;
+	// Headless only: renders benchmarkFrames frames with every transform path.
+	bool transformBenchmark = false;
+};
+
 struct QueueFamilyIndices
 {
 	uint32_t graphicsFamily;
 	uint32_t presentFamily;
+	// A transfer-only family when the device has one, otherwise the graphics family.
+	uint32_t transferFamily;
 };
 
 struct SwapChainSupportDetails
@@ -45,58 +145,87 @@ struct SwapChainSupportDetails
 
 struct Vertex
 {
-	glm::vec2 pos;
+	glm::vec3 pos;
 	glm::vec3 color;
+};
+static_assert(sizeof(Vertex) == FullVertexFormat::stride && offsetof(Vertex, color) == sizeof(glm::vec3));
+
+// Per-instance vertex input, one premultiplied model-view-projection matrix per drawn object in binding 1.
+struct InstanceData
+{
+	glm::mat4 modelViewProj;
 
 	static VkVertexInputBindingDescription GetBindingDescription()
 	{
 		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		bindingDescription.binding = 1;
+		bindingDescription.stride = sizeof(InstanceData);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
 		return bindingDescription;
 	}
 
-	static std::array<VkVertexInputAttributeDescription, 2> GetAttributeDescriptions()
+	// A mat4 input takes one location per column.
+	static std::array<VkVertexInputAttributeDescription, 4> GetAttributeDescriptions(uint32_t firstLocation)
 	{
-		std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
-
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
+		std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			attributeDescriptions[i].binding = 1;
+			attributeDescriptions[i].location = firstLocation + i;
+			attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+			attributeDescriptions[i].offset = offsetof(InstanceData, modelViewProj) + sizeof(glm::vec4) * i;
+		}
 
 		return attributeDescriptions;
 	}
 };
 
+// Per-frame constants. Objects get their matrices premultiplied, so nothing per vertex needs these.
 struct UniformBufferObject
 {
-	glm::mat4 model;
-	glm::mat4 view;
-	glm::mat4 proj;
+	glm::mat4 viewProj;
+	// Bindless storage buffer index of the material table.
+	uint32_t materialBuffer;
+};
+
+// One entry of the material table, indexed by ObjectConstants::materialIndex.
+struct MaterialData
+{
+	glm::vec4 baseColor;
+};
+
+// Per-draw data of the uniform and push-constant transform paths, matching ObjectConstants in
+// res/vertex_object.glsl and res/vertex_push.glsl.
+struct ObjectConstants
+{
+	glm::mat4 modelViewProj;
+	uint32_t materialIndex;
 };
 
 const std::vector<Vertex> vertices = {
-	{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-	{{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
-	{{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
-	{{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}}
+	{{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}},
+	{{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}},
+	{{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+	{{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}}
 };
 const std::vector<uint16_t> indices = {
 	0, 1, 2, 2, 3, 0
 };
-const int MAX_FRAMES_IN_FLIGHT = 2;
+
+const uint64_t TELEMETRY_LOG_INTERVAL = 1000;
+const uint32_t INSTANCE_SWEEP_MAX = 100000;
+// Vertices packed per job system task.
+const uint32_t VERTEX_PACK_BATCH = 65536;
+// Upper bound of minUniformBufferOffsetAlignment, used to size the uniform ring before the device says.
+const VkDeviceSize UNIFORM_MAX_ALIGNMENT = 256;
+// Below this many draws per secondary command buffer the recording is not worth a thread hop.
+const uint32_t MIN_DRAWS_PER_RECORD_TASK = 256;
 
 class VulkanTutorialApplication
 {
 public:
+	void ParseCommandLine(int argc, char* argv[]);
 	void Run();
 
 	const uint32_t WIDTH = 1080;
@@ -104,6 +233,7 @@ public:
 	std::vector<const char*> m_validationLayers = {"VK_LAYER_KHRONOS_validation"};
 	std::vector<const char*> m_deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 	bool m_enableValidationLayers = true;
+	ApplicationOptions m_options;
 	GLFWwindow* m_window;
 	VkInstance m_instance;
 	VkDebugUtilsMessengerEXT m_debugMessenger;
@@ -111,11 +241,14 @@ public:
 
 	VkPhysicalDevice m_physicalDevice;
 	VkDevice m_device;
+	GpuAllocator m_allocator;
+	StagingUploader m_uploader;
 	VkQueue m_graphicsQueue;
 	VkQueue m_presentQueue;
+	VkQueue m_transferQueue;
 
 	std::vector<const char*> GetRequiredExtensions();
-	VkSwapchainKHR m_swapChain;
+	VkSwapchainKHR m_swapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> m_swapChainImages;
 	std::vector<VkImageView> m_swapChainImageViews;
 	std::vector<VkFramebuffer> m_swapChainFrameBuffers;
@@ -125,7 +258,15 @@ public:
 	VkDescriptorSetLayout m_descriptorSetLayout;
 	VkPipelineLayout m_pipelineLayout;
 	VkRenderPass m_renderPass;
-	VkPipeline m_graphicsPipeline;
+	JobSystem m_jobs;
+	PipelineCache m_pipelineCache;
+	PipelineLibrary m_pipelineLibrary;
+	// Owns m_descriptorSetLayout and m_pipelineLayout, both reflected from the shaders.
+	LayoutCache m_layoutCache;
+	PipelineDesc m_mainPipeline;
+	ShaderHotReload m_shaderReload;
+	double m_initMilliseconds = 0.0;
+	double m_pipelineMilliseconds = 0.0;
 	VkCommandPool m_commandPool;
 	std::vector<VkCommandBuffer> m_commandBuffers;
 	std::vector<VkSemaphore> m_imageAvailableSemaphores;
@@ -133,16 +274,101 @@ public:
 	std::vector<VkFence> m_inFlightFences;
 	uint32_t currentFrame = 0;
 	bool m_framebufferResized = false;
+	// Set while the window is minimized: the swapchain must be recreated before the next frame.
+	bool m_swapChainStale = false;
+	// Instance support for VK_EXT_swapchain_maintenance1, which needs VK_EXT_surface_maintenance1.
+	bool m_supportsSurfaceMaintenance = false;
+	// VK_EXT_swapchain_maintenance1 is enabled, so every present signals a fence once it is done.
+	bool m_supportsPresentFences = false;
+	// One per frame in flight, reused by the present of the frame in that slot.
+	std::vector<VkFence> m_presentFences;
+	// The number of the present that last used each of m_presentFences.
+	std::vector<uint64_t> m_presentFenceNumbers;
+	uint64_t m_presentCount = 0;
+	// Whether each image of the current swapchain has been presented.
+	std::vector<bool> m_swapChainImagesPresented;
+	struct RetiredSwapChain
+	{
+		VkSwapchainKHR swapChain;
+		// m_presentCount when it was replaced, the number of its last present.
+		uint64_t lastPresent;
+	};
+	// Replaced swapchains that a present may still use. Frame fences only cover the graphics submissions.
+	std::vector<RetiredSwapChain> m_retiredSwapChains;
+	// The deletion queue's number for each frame in flight's last submission.
+	std::vector<uint64_t> m_frameSubmissions;
+	// Everything replaced at runtime, such as a resized swapchain's objects, goes through here.
+	DeletionQueue m_deletionQueue;
 
 	VkBuffer m_vertexBuffer;
-	VkDeviceMemory m_vertexBufferMemory;
+	Allocation m_vertexBufferAllocation;
 	VkBuffer m_indexBuffer;
-	VkDeviceMemory m_indexBufferMemory;
-	std::vector<VkBuffer> m_uniformBuffers;
-	std::vector<VkDeviceMemory> m_uniformBuffersMemory;
-	std::vector<void*> m_uniformBuffersMapped;
+	Allocation m_indexBufferAllocation;
+	MeshFile m_meshFile;
+	// The optimized copy of m_meshFile's data, only held until it is uploaded.
+	std::vector<Vertex> m_meshVertices;
+	std::vector<uint32_t> m_meshIndices;
+	MeshOptimizationStats m_meshOptimization;
+	// Index ranges of the mesh's LODs, all over the same vertex buffer. A single entry without LODs.
+	std::vector<MeshLod> m_meshLods;
+	// Current LOD of every instance, for CPU-recorded draws.
+	std::vector<uint8_t> m_instanceLods;
+	VkIndexType m_indexType = VK_INDEX_TYPE_UINT16;
+	uint32_t m_indexCount = 0;
+	uint32_t m_vertexCount = 0;
+	VkDeviceSize m_vertexBufferBytes = 0;
+	// Centers the loaded mesh on the origin and scales it to unit radius.
+	glm::mat4 m_meshTransform = glm::mat4(1.0f);
+	InstanceBuffer m_instances;
+	uint32_t m_nextDynamicInstance = 0;
+	uint64_t m_instanceBytesWritten = 0;
+	std::string m_instanceSweepJson;
+	// Mesh-space bounding sphere, xyz center and w radius.
+	glm::vec4 m_meshBoundingSphere = glm::vec4(0.0f);
+	bool m_supportsIndirectCount = false;
+	bool m_gpuCulling = false;
+	GpuCuller m_culler;
+	uint32_t m_visibleInstances = 0;
+	ThreadCommandPools m_threadCommandPools;
+	ThreadCommandPools m_framePools;
+	struct CachedCommandBuffer
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint64_t version = UINT64_MAX;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+	};
+	// Indexed by frame in flight * swapchain image count + image.
+	std::vector<CachedCommandBuffer> m_cachedCommandBuffers;
+	// Bumped whenever recorded commands would differ, which invalidates every cached command buffer.
+	uint64_t m_commandsVersion = 0;
+	uint64_t m_commandBufferRecords = 0;
+	UniformRing m_uniformRing;
+	uint32_t m_uniformOffset = 0;
+	TransformPath m_transformPath = TransformPath::Instanced;
+	// Object model matrices and the camera; the instance buffer receives their products.
+	TransformSystem m_transforms;
+	bool m_viewProjectionChanged = false;
+	bool m_allTransformsDirty = false;
+	// Object i's constants are at m_objectUniformOffset + i * m_objectUniformStride on the uniform path.
+	uint32_t m_objectUniformOffset = 0;
+	uint32_t m_objectUniformStride = 0;
+	std::string m_transformBenchmarkJson;
 	VkDescriptorPool m_descriptorPool;
-	std::vector<VkDescriptorSet> m_descriptorSets;
+	VkDescriptorSet m_descriptorSet;
+	// Set 1 of every pipeline: all buffers, images and samplers, reached by index.
+	BindlessDescriptors m_bindless;
+	TextureStreamer m_textures;
+	std::vector<uint32_t> m_textureHandles;
+	VkBuffer m_materialBuffer;
+	Allocation m_materialBufferAllocation;
+	uint32_t m_materialBufferIndex = 0;
+
+	std::vector<Allocation> m_offscreenImagesAllocations;
+	GpuProfiler m_gpuProfiler;
+	uint32_t m_framesInFlight = 2;
+	FrameTelemetry m_telemetry;
+	std::vector<std::chrono::high_resolution_clock::time_point> m_frameSubmitTimes;
+	std::vector<bool> m_frameLatencyPending;
 
 	void InitWindow();
 	void InitVulkan();
@@ -159,27 +385,47 @@ public:
 	SwapChainSupportDetails QuerySwapChainSupport();
 	void CreateSwapChain();
 	void CreateImageViews();
+	void CreateOffscreenTargets();
+	void WriteBenchmarkReport(double totalSeconds);
 	void CreateRenderPass();
 	void CreateGraphicsPipeline();
 	void CreateFrameBuffers();
 	void CreateCommandPool();
 	void CreateCommandBuffer();
 	void CleanupSwapChain();
-	void RecreateSwapChain();
-	VkShaderModule CreateShaderModule(std::vector<char>& code);
+	// Returns false, leaving the old swapchain in place, while the window has no area.
+	bool RecreateSwapChain();
+	void ReleaseRetiredSwapChains(bool presentedImageAcquired);
 	void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	VkCommandBuffer PrepareCommandBuffer(uint32_t imageIndex);
+	void CreateCachedCommandBuffers();
+	std::vector<VkCommandBuffer> RecordSecondaryDraws(uint32_t imageIndex, VkPipeline pipeline);
+	void RecordDraws(VkCommandBuffer commandBuffer, VkPipeline pipeline, uint32_t firstInstance, uint32_t instanceCount);
+	void SetTransformPath(TransformPath path);
+	bool DrawsPerObject() const;
 	void DrawFrame();
+	void PollFrameLatency();
 	void CreateSyncObjects();
+	void PrepareLoadedMesh();
+	bool UpdateInstanceLods(uint32_t first, uint32_t count);
 	void CreateVertexBuffer();
 	void CreateIndexBuffer();
+	void CreateMaterials();
 	void CreateUniformBuffers();
 	void CreateDescriptorPool();
 	void CreateDescriptorSets();
 	void UpdateUniformBuffer(uint32_t currentImage);
-	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	void CreateInstances();
+	void LayoutInstances(uint32_t count);
+	void UpdateInstances();
+	void UpdateObjectConstants();
+	double RunBenchmarkFrames();
+	void RunInstanceSweep();
+	void RunTransformBenchmark();
+	void CreateGpuCulling();
 	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer,
-	                  VkDeviceMemory& bufferMemory);
-	void CopyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size);
+	                  Allocation& allocation);
+	void DestroyBuffer(VkBuffer buffer, const Allocation& allocation);
 	void CreateDescriptorSetLayout();
 	void MainLoop();
 	void Cleanup();
@@ -1,3 +1,6 @@
 C:\VulkanSDK\1.3.236.0\Bin\glslc.exe --target-env=vulkan1.3 -fshader-stage=vert .\vertex.glsl -o vertex.spv
+C:\VulkanSDK\1.3.236.0\Bin\glslc.exe --target-env=vulkan1.3 -fshader-stage=vert .\vertex_object.glsl -o vertex_object.spv
+C:\VulkanSDK\1.3.236.0\Bin\glslc.exe --target-env=vulkan1.3 -fshader-stage=vert .\vertex_push.glsl -o vertex_push.spv
 C:\VulkanSDK\1.3.236.0\Bin\glslc.exe --target-env=vulkan1.3 -fshader-stage=frag .\fragment.glsl -o fragment.spv
+C:\VulkanSDK\1.3.236.0\Bin\glslc.exe --target-env=vulkan1.3 -fshader-stage=comp .\cull.glsl -o cull.spv
 pause
\ No newline at end of file
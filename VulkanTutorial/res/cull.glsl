@@ -0,0 +1,84 @@
+#version 450
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) readonly buffer Instances {
+    mat4 instanceModelViewProjs[];
+};
+
+struct DrawIndexedIndirectCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, binding = 1) writeonly buffer DrawCommands {
+    DrawIndexedIndirectCommand draws[];
+};
+
+layout(std430, binding = 2) buffer DrawCount {
+    uint drawCount;
+};
+
+layout(push_constant) uniform CullParameters {
+    // Bounding sphere of the mesh in its own space: xyz center, w radius.
+    vec4 boundingSphere;
+    // Up to four LODs, in mesh units and index buffer ranges.
+    vec4 lodErrors;
+    uvec4 lodFirstIndices;
+    uvec4 lodIndexCounts;
+    vec2 viewportHalfSize;
+    float lodErrorPixels;
+    uint lodCount;
+    uint objectCount;
+} params;
+
+// Same selection as SelectLod in MeshSimplifier.cpp: the coarsest LOD whose error, projected from where
+// the bounding sphere comes closest to the camera, stays within lodErrorPixels.
+uint SelectLod(mat4 rows, vec3 center, float radius) {
+    float depth = dot(rows[3].xyz, center) + rows[3].w - radius * length(rows[3].xyz);
+    if (depth <= 0.0)
+        return 0;
+
+    float pixelsPerUnit = max(length(rows[0].xyz) * params.viewportHalfSize.x,
+        length(rows[1].xyz) * params.viewportHalfSize.y) / depth;
+    uint lod = 0;
+    for (uint i = 1; i < params.lodCount; i++) {
+        if (params.lodErrors[i] * pixelsPerUnit <= params.lodErrorPixels)
+            lod = i;
+    }
+    return lod;
+}
+
+void main() {
+    uint object = gl_GlobalInvocationID.x;
+    if (object >= params.objectCount)
+        return;
+
+    // Gribb-Hartmann planes of the instance's model-view-projection matrix are the frustum planes in mesh
+    // space, so the mesh's own bounding sphere is tested directly. Vulkan clip depth is [0, w].
+    mat4 clip = transpose(instanceModelViewProjs[object]);
+    vec4 planes[6] = vec4[](
+        clip[3] + clip[0],
+        clip[3] - clip[0],
+        clip[3] + clip[1],
+        clip[3] - clip[1],
+        clip[2],
+        clip[3] - clip[2]);
+
+    vec3 center = params.boundingSphere.xyz;
+    float radius = params.boundingSphere.w;
+    for (int i = 0; i < 6; i++) {
+        if (dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz))
+            return;
+    }
+
+    uint lod = SelectLod(clip, center, radius);
+    uint slot = atomicAdd(drawCount, 1);
+    draws[slot].indexCount = params.lodIndexCounts[lod];
+    draws[slot].instanceCount = 1;
+    draws[slot].firstIndex = params.lodFirstIndices[lod];
+    draws[slot].vertexOffset = 0;
+    draws[slot].firstInstance = object;
+}
\ No newline at end of file
@@ -1,8 +1,24 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 fColor;
+layout(location = 1) flat in uint fMaterial;
 layout(location = 0) out vec4 outColor;
 
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 viewProj;
+    uint materialBuffer;
+} ubo;
+
+struct Material {
+    vec4 baseColor;
+};
+
+// Every storage buffer of the global bindless set; the frame constants say which one holds materials.
+layout(std430, set = 1, binding = 0) readonly buffer Materials {
+    Material materials[];
+} bindlessBuffers[];
+
 void main() {
-    outColor = vec4(fColor, 1.0);
+    outColor = vec4(fColor, 1.0) * bindlessBuffers[ubo.materialBuffer].materials[fMaterial].baseColor;
 }
\ No newline at end of file
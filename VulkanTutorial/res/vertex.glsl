@@ -1,17 +1,14 @@
 #version 450
-layout(location = 0) in vec2 position;
+layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
+layout(location = 2) in mat4 instanceModelViewProj;
 
 layout(location = 0) out vec3 fColor;
+layout(location = 1) flat out uint fMaterial;
 
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
-    mat4 view;
-    mat4 proj;
-} ubo;
-
 void main() {
     fColor = color;
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 0.0, 1.0);
+    fMaterial = 0;
+    gl_Position = instanceModelViewProj * vec4(position, 1.0);
 }
\ No newline at end of file
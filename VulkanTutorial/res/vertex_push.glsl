@@ -0,0 +1,17 @@
+#version 450
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+
+layout(location = 0) out vec3 fColor;
+layout(location = 1) flat out uint fMaterial;
+
+layout(push_constant) uniform ObjectConstants {
+    mat4 modelViewProj;
+    uint materialIndex;
+} object;
+
+void main() {
+    fColor = color;
+    fMaterial = object.materialIndex;
+    gl_Position = object.modelViewProj * vec4(position, 1.0);
+}
\ No newline at end of file